@@ -0,0 +1,102 @@
+/*
+    ExploreFractals, a tool for testing the effect of Mandelbrot set Julia morphings
+    Copyright (C) 2021  DinkydauSet
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANIMATIONLOG_H
+#define ANIMATIONLOG_H
+
+//standard library
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <iomanip>
+#include <mutex>
+#include <chrono>
+
+//this program
+#include "common.cpp"
+
+//for example 2h 05m, 3m 10s or 12s
+string durationString(double seconds)
+{
+	uint64 s = (uint64)max(0.0, seconds);
+	std::ostringstream out;
+	if (s >= 3600)
+		out << s / 3600 << "h " << setfill('0') << setw(2) << (s / 60) % 60 << "m";
+	else if (s >= 60)
+		out << s / 60 << "m " << setfill('0') << setw(2) << s % 60 << "s";
+	else
+		out << s << "s";
+	return out.str();
+}
+
+/*
+	Records how long every frame of an animation took, to find frames that take much longer than the others and to know when a long render will be done.
+
+	Every finished frame adds a line with a JSON object to the log file (JSON lines), for example:
+		{"frame":12,"finished":1634567890,"render_seconds":1.53,"encode_seconds":0.21,"computed_iterations":123456789,"guessed_points":50000,"calculated_points":206000,"points":256000,"threads":12}
+	finished is the time in seconds since 1970. The log is appended to, so a log of an animation that's rendered in several parts (see --shard) contains all frames.
+
+	After every frame a progress line is printed with the rate in frames per hour and the expected time until all frames are done.
+*/
+class AnimationLog {
+	string filename;
+	uint total_frames; //the number of frames that this process renders
+	uint finished_frames{ 0 };
+	chrono::time_point<chrono::high_resolution_clock> start;
+	mutex logMutex;
+
+public:
+	AnimationLog(string filename, uint total_frames)
+	: filename(filename)
+	, total_frames(total_frames)
+	, start(chrono::high_resolution_clock::now())
+	{}
+
+	//This can be used from several threads.
+	void frameFinished(int frame, const RenderStatistics& stats, double encode_seconds)
+	{
+		std::ostringstream line;
+		line << "{\"frame\":" << frame
+			<< ",\"finished\":" << (int64)time(nullptr)
+			<< ",\"render_seconds\":" << stats.seconds
+			<< ",\"encode_seconds\":" << encode_seconds
+			<< ",\"computed_iterations\":" << stats.computed_iterations
+			<< ",\"guessed_points\":" << stats.guessed_points
+			<< ",\"calculated_points\":" << stats.calculated_points
+			<< ",\"points\":" << stats.points
+			<< ",\"threads\":" << stats.threads
+			<< "}\n";
+		string text = line.str();
+
+		lock_guard<mutex> guard(logMutex);
+		if ( ! appendLine(filename, text))
+			cout << "error while writing to the log " << filename << endl;
+
+		finished_frames++;
+		chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+		double frames_per_hour = finished_frames / elapsed.count() * 3600;
+		double remaining = (total_frames - min(finished_frames, total_frames)) * elapsed.count() / finished_frames;
+		std::ostringstream rate;
+		rate << fixed << setprecision(1) << frames_per_hour;
+		cout << "progress: " << finished_frames << " / " << total_frames << " frames, " << rate.str() << " frames per hour, "
+			<< "elapsed " << durationString(elapsed.count()) << ", ETA " << durationString(remaining) << endl;
+	}
+};
+
+
+#endif
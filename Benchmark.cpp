@@ -0,0 +1,392 @@
+/*
+    ExploreFractals, a tool for testing the effect of Mandelbrot set Julia morphings
+    Copyright (C) 2021  DinkydauSet
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+//standard library
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <functional>
+
+//rapidjson
+#include "rapidjson/document.h"
+
+//this program
+#include "common.cpp"
+#include "FractalParameters.cpp"
+#include "FractalCanvas.cpp"
+#include "Render.cpp"
+
+/*
+	The benchmark renders a fixed set of views with every procedure, with and without AVX and with different numbers of threads, to find out whether a change makes the program faster or slower. Claims like "this turns out to be faster" can be checked with it.
+
+	Every view is chosen for a different kind of work:
+		sparse exterior: the whole set, where most points escape quickly and large areas can be guessed
+		dense boundary: filaments in the seahorse valley, where almost nothing can be guessed
+		minibrot: a minibrot that fills a large part of the view. Its inside isn't in the cardioid, so it has to be iterated up to maxIters.
+		many inflections: 12 inflections, so every point is transformed a lot before it's iterated
+		julia: a Julia set, for the procedures that have a Julia version
+*/
+struct BenchmarkView {
+	string name;
+	bool julia;
+	std::function<void(FractalParameters&)> setup;
+};
+
+vector<BenchmarkView> benchmarkViews()
+{
+	const double_c seahorse_valley = -0.743644786 + 0.1318252536*I;
+	return {
+		{"sparse exterior", false, [=](FractalParameters& P) {
+			P.setCenterAndZoomAbsolute(-0.5, 0);
+			P.setMaxIters(1000);
+		}},
+		{"dense boundary", false, [=](FractalParameters& P) {
+			P.setCenterAndZoomAbsolute(seahorse_valley, 12);
+			P.setMaxIters(4000);
+		}},
+		{"minibrot", false, [=](FractalParameters& P) {
+			P.setCenterAndZoomAbsolute(-1.7548776662466927, 6);
+			P.setMaxIters(2000);
+		}},
+		{"many inflections", false, [=](FractalParameters& P) {
+			P.setCenterAndZoomAbsolute(seahorse_valley, 12);
+			P.setMaxIters(2000);
+			P.setInflectionZoomLevel();
+			for (int i=0; i<12; i++)
+				P.addInflection(seahorse_valley);
+		}},
+		{"julia", true, [=](FractalParameters& P) {
+			P.setJulia(true);
+			P.setJuliaSeed(-0.75 + 0.1*I);
+			P.setCenterAndZoomAbsolute(0, 0.5);
+			P.setMaxIters(2000);
+		}},
+	};
+}
+
+//the procedures that the benchmark uses, all except the debug test
+const vector<int> benchmarkProcedureIDs = {
+	M2.id, M3.id, M4.id, M5.id, M512.id, HIGH_POWER.id, BURNING_SHIP.id, TRIPLE_MATCHMAKER.id, CHECKERS.id, RECURSIVE_FRACTAL.id, PURE_MORPHINGS.id
+};
+
+constexpr uint BENCHMARK_WIDTH = 480;
+constexpr uint BENCHMARK_HEIGHT = 320;
+constexpr int BENCHMARK_REPETITIONS = 3; //every render is done this many times and the fastest one counts, because the first render can be slower and other programs can disturb one
+constexpr double BENCHMARK_REPETITION_SECONDS = 2; //except for slow renders: a render isn't repeated when the repetitions took this long already
+constexpr double BENCHMARK_TOLERANCE = 0.1; //a result is a regression if it's more than this much slower than the baseline
+
+struct BenchmarkResult {
+	string name; //the procedure, view, size, AVX and threads. Results with the same name can be compared.
+	double miter_per_second{ 0 };
+	double points_per_second{ 0 };
+	double guess_ratio{ 0 }; //the part of the points that was guessed
+	double efficiency{ 0 }; //the speed with n threads compared to n times the speed with 1 thread, or 0 if there's no result with 1 thread
+
+	string toJson() const {
+		std::ostringstream line;
+		line << setprecision(6)
+			<< "{\"name\":\"" << name << "\""
+			<< ",\"miter_per_second\":" << miter_per_second
+			<< ",\"points_per_second\":" << points_per_second
+			<< ",\"guess_ratio\":" << guess_ratio
+			<< ",\"efficiency\":" << efficiency
+			<< "}";
+		return line.str();
+	}
+};
+
+//Reads the results of an earlier benchmark that were saved with --benchmark-save, one JSON object per line. Returns false if the file can't be read.
+bool readBenchmarkResults(string filename, map<string, BenchmarkResult>& results)
+{
+	ifstream file(filename);
+	if ( ! file.is_open())
+		return false;
+	string line;
+	while (getline(file, line)) {
+		rapidjson::Document document;
+		if (document.Parse(line.c_str()).HasParseError() || ! document.IsObject())
+			continue;
+		if ( ! document.HasMember("name") || ! document.HasMember("points_per_second") || ! document.HasMember("miter_per_second"))
+			continue;
+		BenchmarkResult result;
+		result.name = document["name"].GetString();
+		result.miter_per_second = document["miter_per_second"].GetDouble();
+		result.points_per_second = document["points_per_second"].GetDouble();
+		if (document.HasMember("guess_ratio"))
+			result.guess_ratio = document["guess_ratio"].GetDouble();
+		if (document.HasMember("efficiency"))
+			result.efficiency = document["efficiency"].GetDouble();
+		results[result.name] = result;
+	}
+	return true;
+}
+
+bool writeBenchmarkResults(string filename, const vector<BenchmarkResult>& results)
+{
+	ofstream file(filename, ios::binary);
+	for (const BenchmarkResult& result : results)
+		file << result.toJson() << "\n";
+	file.close();
+	if ( ! file) {
+		cout << "error while writing the benchmark results to " << filename << endl;
+		return false;
+	}
+	return true;
+}
+
+/*
+	Runs the benchmark on canvas with 1, 2, 4 etc. up to canvas.number_of_threads threads. Only the views whose name (for example "Mandelbrot power 2, julia") contains filter are rendered. overrideSize is applied to the parameters of every view, for the command line options that change the size.
+
+	The results are compared with those in baseline_file, if it's not empty. The speed in points per second is compared, because a change that guesses more points makes the render faster with fewer iterations. Returns false if a result is a regression.
+*/
+bool runBenchmark(FractalCanvas& canvas, std::function<void(FractalParameters&)> overrideSize, string filter, string baseline_file, string save_file)
+{
+	map<string, BenchmarkResult> baseline;
+	if ( ! baseline_file.empty() && ! readBenchmarkResults(baseline_file, baseline))
+		cout << "could not read the benchmark baseline " << baseline_file << endl;
+
+	vector<uint> threadCounts;
+	uint max_threads = canvas.number_of_threads;
+	for (uint threads = 1; threads < max_threads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(max_threads);
+
+	bool avx_available = using_avx;
+	vector<BenchmarkResult> results;
+	vector<string> lines;
+	int regressions = 0;
+
+	for (int id : benchmarkProcedureIDs)
+	for (const BenchmarkView& view : benchmarkViews())
+	for (bool avx : {false, true})
+	{
+		Procedure procedure = getProcedureObject(id);
+		if (view.julia && ! procedure.hasJuliaVersion)
+			continue;
+		if (avx && ! (avx_available && procedure.hasAvxVersion))
+			continue;
+
+		FractalParameters P;
+		P.resize(BENCHMARK_WIDTH, BENCHMARK_HEIGHT, 1, 1);
+		P.setProcedure(id);
+		view.setup(P);
+		overrideSize(P);
+
+		string name = procedure.name() + ", " + view.name;
+		if (name.find(filter) == string::npos)
+			continue;
+		name += ", " + to_string(P.width_canvas()) + "x" + to_string(P.height_canvas());
+		if (avx)
+			name += ", avx";
+
+		ResizeResult res = canvas.changeParameters(P);
+		if ( ! res.success) {
+			cout << "The benchmark view " << name << " can't be rendered." << endl;
+			continue;
+		}
+
+		using_avx = avx;
+		double single_thread_points_per_second = 0;
+		for (uint threads : threadCounts)
+		{
+			canvas.number_of_threads = threads;
+			RenderStatistics fastest;
+			double total_seconds = 0;
+			for (int repetition = 0; repetition < BENCHMARK_REPETITIONS && total_seconds < BENCHMARK_REPETITION_SECONDS; repetition++) {
+				canvas.createNewRender(); //the whole render takes place in this thread
+				total_seconds += canvas.lastRenderStatistics.seconds;
+				if (repetition == 0 || canvas.lastRenderStatistics.seconds < fastest.seconds)
+					fastest = canvas.lastRenderStatistics;
+			}
+
+			BenchmarkResult result;
+			result.name = name + ", " + to_string(threads) + (threads == 1 ? " thread" : " threads");
+			double seconds = max(fastest.seconds, 1e-9);
+			result.miter_per_second = fastest.computed_iterations / seconds / 1000000;
+			result.points_per_second = fastest.points / seconds;
+			result.guess_ratio = (double)fastest.guessed_points / max<uint64>(fastest.points, 1);
+			if (threads == 1)
+				single_thread_points_per_second = result.points_per_second;
+			if (single_thread_points_per_second > 0)
+				result.efficiency = result.points_per_second / (threads * single_thread_points_per_second);
+
+			std::ostringstream line;
+			line << fixed << setprecision(1) << result.name << ": "
+				<< result.miter_per_second << " Miter/s, "
+				<< setprecision(3) << result.points_per_second / 1000000 << " Mpoints/s, "
+				<< setprecision(1) << result.guess_ratio * 100 << "% guessed, "
+				<< "efficiency " << result.efficiency * 100 << "%";
+			auto base = baseline.find(result.name);
+			if (base != baseline.end() && base->second.points_per_second > 0) {
+				double change = result.points_per_second / base->second.points_per_second - 1;
+				line << ", " << showpos << change * 100 << noshowpos << "% compared to the baseline";
+				if (change < -BENCHMARK_TOLERANCE) {
+					line << " REGRESSION";
+					regressions++;
+				}
+			}
+			cout << "benchmark: " << line.str() << endl;
+			lines.push_back(line.str());
+			results.push_back(result);
+		}
+	}
+	using_avx = avx_available;
+	canvas.number_of_threads = max_threads;
+
+	//The renders print a lot, so all results are printed together at the end.
+	cout << endl << "benchmark results:" << endl;
+	for (const string& line : lines)
+		cout << line << endl;
+	if ( ! baseline.empty())
+		cout << regressions << " of " << results.size() << " results are more than " << (int)(BENCHMARK_TOLERANCE * 100) << "% slower than the baseline" << endl;
+
+	if ( ! save_file.empty())
+		writeBenchmarkResults(save_file, results);
+	return regressions == 0;
+}
+
+
+/*
+	The kernel benchmark calls Render::calcPoint and Render::calcPointVectorAVX_M2 directly for a fixed set of points, in one thread, without the render algorithm and without coloring. It measures only the calculation of the points, so that changes to the calculations can be compared without the noise of the threads and the guessing.
+
+	The points are those of a small canvas on one of these views, which is calculated with several values of maxIters:
+		exterior: points that escape after a few iterations, which shows the work per point
+		boundary: the seahorse valley, where the points need very different numbers of iterations
+		interior: the inside of a minibrot, where every point needs maxIters iterations. It's not in the cardioid, so the cardioid check doesn't skip it.
+	The views are chosen for Mandelbrot power 2. For the other procedures they're the same points, which can be exterior or interior in a different way.
+
+	Cycles are counted with the time stamp counter, which on most processors runs at a constant rate that can differ from the clock speed of the core.
+	Lane utilization is for the AVX kernel: the part of the work that's done with all 4 lanes of the vector. The points at the end that are finished without AVX count as if they use 1 of 4 lanes.
+*/
+struct KernelPointSet {
+	string name;
+	double_c center;
+	double zoom;
+};
+
+const vector<KernelPointSet> kernelPointSets = {
+	{"exterior", 1.0 + 1.0*I, 2},
+	{"boundary", -0.743644786 + 0.1318252536*I, 12},
+	{"interior", -1.7548776662466927, 10},
+};
+const vector<uint> kernelBenchmarkMaxIters = { 100, 1000, 10000 };
+constexpr uint KERNEL_BENCHMARK_SIZE = 64; //the points are those of a canvas of this size
+
+template <int procedure_identifier, bool use_avx>
+void benchmarkKernel(FractalCanvas& canvas, string filter)
+{
+	Procedure procedure = getProcedureObject(procedure_identifier);
+	using KernelRender = Render<procedure_identifier, use_avx, false>;
+
+	for (const KernelPointSet& set : kernelPointSets)
+	for (uint maxIters : kernelBenchmarkMaxIters)
+	{
+		string name = procedure.name() + (use_avx ? " avx" : "") + ", " + set.name;
+		if (name.find(filter) == string::npos)
+			continue;
+		name += ", maxIters " + to_string(maxIters);
+
+		canvas.changeParameters([&](FractalParameters& P) {
+			P.resize(KERNEL_BENCHMARK_SIZE, KERNEL_BENCHMARK_SIZE, 1, 1);
+			P.setProcedure(procedure_identifier);
+			P.setJulia(false);
+			P.setMaxIters(maxIters);
+			P.setCenterAndZoomAbsolute(set.center, set.zoom);
+		});
+		if ( ! canvas.updateCountWidth()) {
+			cout << "not enough memory for the kernel benchmark " << name << endl;
+			continue;
+		}
+
+		vector<point> points;
+		for (uint y = 0; y < canvas.P().height_canvas(); y++)
+			for (uint x = 0; x < canvas.P().width_canvas(); x++)
+				points.push_back({x, y});
+
+		//the fastest repetition counts
+		uint64 iterations = 0, cycles = 0, steps = 0, tailIterations = 0;
+		double seconds = 0, total_seconds = 0;
+		for (int repetition = 0; repetition < BENCHMARK_REPETITIONS && total_seconds < BENCHMARK_REPETITION_SECONDS; repetition++)
+		{
+			KernelRender R(canvas, canvas.lastRenderID);
+			R.useCounterSlot(0);
+			uint64 repetitionIterations = 0;
+
+			auto start = chrono::high_resolution_clock::now();
+			uint64 startCycles = __rdtsc();
+			if constexpr(use_avx) {
+				R.calcPointVectorAVX_M2(typename KernelRender::PointList{points.data()}, 0, points.size(), repetitionIterations);
+			}
+			else {
+				for (point p : points)
+					R.calcPoint(p.x, p.y, repetitionIterations);
+			}
+			uint64 repetitionCycles = __rdtsc() - startCycles;
+			double repetitionSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+			total_seconds += repetitionSeconds;
+			if (repetition == 0 || repetitionCycles < cycles) {
+				iterations = repetitionIterations;
+				cycles = repetitionCycles;
+				seconds = repetitionSeconds;
+				steps = R.counterSlots[0].avxSteps;
+				tailIterations = R.counterSlots[0].avxTailIterations;
+			}
+		}
+
+		std::ostringstream line;
+		line << fixed << setprecision(2) << name << ": "
+			<< points.size() << " points, " << iterations << " iterations, ";
+		if (iterations > 0) {
+			line << (double)cycles / iterations << " cycles per iteration, "
+				<< seconds / iterations * 1e9 << " ns per iteration";
+		}
+		else {
+			line << (double)cycles / points.size() << " cycles per point";
+		}
+		if (use_avx && steps + tailIterations > 0)
+			line << ", lane utilization " << setprecision(1) << 100.0 * (4 * steps + tailIterations) / (4 * (steps + tailIterations)) << "%";
+		cout << line.str() << endl;
+	}
+}
+
+//Runs the kernel benchmark for all procedures whose name contains filter. The AVX kernel is only used if the processor supports it.
+void runKernelBenchmark(FractalCanvas& canvas, string filter)
+{
+	benchmarkKernel<M2.id, false>(canvas, filter);
+	if (using_avx)
+		benchmarkKernel<M2.id, true>(canvas, filter);
+	benchmarkKernel<M3.id, false>(canvas, filter);
+	benchmarkKernel<M4.id, false>(canvas, filter);
+	benchmarkKernel<M5.id, false>(canvas, filter);
+	benchmarkKernel<M512.id, false>(canvas, filter);
+	benchmarkKernel<HIGH_POWER.id, false>(canvas, filter);
+	benchmarkKernel<BURNING_SHIP.id, false>(canvas, filter);
+	benchmarkKernel<TRIPLE_MATCHMAKER.id, false>(canvas, filter);
+	benchmarkKernel<CHECKERS.id, false>(canvas, filter);
+	benchmarkKernel<RECURSIVE_FRACTAL.id, false>(canvas, filter);
+	benchmarkKernel<PURE_MORPHINGS.id, false>(canvas, filter);
+}
+
+
+#endif
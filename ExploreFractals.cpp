@@ -23,9 +23,14 @@
 #include <iomanip>	//for setfill and setw, to make framenumbers with leading zeros such as frame000001.png
 #include <chrono>
 #include <thread>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
 //#include <random>
 #include <fstream>
 #include <regex>
+#include <filesystem>
+#include <algorithm>
 #include <codecvt>	//to convert utf16 to utf8
 #include <locale>
 
@@ -41,6 +46,12 @@
 #include "Render.cpp"
 #include "windows_util.cpp"
 #include "utilities.cpp"
+#include "StreamingImage.cpp"
+#include "IterationDataFile.cpp"
+#include "FrameManifest.cpp"
+#include "AnimationLog.cpp"
+#include "RenderStatisticsLog.cpp"
+#include "Benchmark.cpp"
 #include "test.cpp"
 
 
@@ -75,6 +86,7 @@ void FractalCanvas::createNewRenderTemplated(uint renderID)
 		cout << "renderID: " << renderID << endl;
 		cout << "FractalCanvas: " << voidPtr() << endl;
 		cout << "Procedure: " << mP.get_procedure().name() << (julia ? " julia" : "") << (use_avx ? " (avx)" : "") << endl;
+		cout << "Algorithm: " << render_algorithm_name(R.algorithm) << endl;
 		cout << "width: " << width << endl;
 		cout << "height: " << height << endl;
 		cout << "center: " << real(center) << " + " << imag(center) << " * I" << endl;
@@ -91,8 +103,10 @@ void FractalCanvas::createNewRenderTemplated(uint renderID)
 	bool cancelled = lastRenderID != renderID;
 
 	if(debug) if(cancelled) cout << "createNewRender found that the render was cancelled" << endl;
-	if ( ! cancelled)
+	if ( ! cancelled) {
+		updateLargestEscapedCount();
 		renderFinishedEvent(static_pointer_cast<RenderInterface>(render), renderID);
+	}
 
 	{
 		//Printing information after the render
@@ -101,52 +115,64 @@ void FractalCanvas::createNewRenderTemplated(uint renderID)
 		cout << "Elapsed time: " << elapsedString << endl;
 		cout << "computed iterations: " << R.computedIterations << endl;
 		cout << "iterations per second: " << ((uint64)(R.computedIterations / R.getElapsedTime()) / 1000000.0) << " M" << endl;
-		cout << "used threads: " << R.usedThreads / 2 << endl; // divide by 2 because each thread is counted when created and when destroyed by addToThreadcount
+		cout << "used threads: " << number_of_threads << endl;
 		cout << "guessedPixelCount: " << R.guessedPixelCount << " / " << width * height << " = " << (double)R.guessedPixelCount / (width*height) << endl;
 		cout << "calculatedPixelCount" << R.calculatedPixelCount << " / " << width * height << " = " << (double)R.calculatedPixelCount / (width*height) << endl;
 		cout << "pixelGroupings: " << R.pixelGroupings << endl;
 	}
-}
-
-
-
-void animation(
-	string path
-	,bool save_only_parameters
-	,int skipframes
-	,int framesPerInflection
-	,int framesPerZoom
-	,FractalCanvas& canvas
-) {
-	FractalParameters& P = canvas.Pmutable();
+	RenderStatistics stats;
+	stats.seconds = R.getElapsedTime();
+	stats.computed_iterations = R.computedIterations;
+	stats.guessed_points = R.guessedPixelCount;
+	stats.calculated_points = R.calculatedPixelCount;
+	stats.points = (uint64)width * height;
+	stats.threads = number_of_threads;
+	stats.raster_seconds = R.rasterSeconds;
+	stats.tile_seconds = R.tileSeconds;
+	stats.bitmap_seconds = R.bitmapNanoseconds / 1e9;
+	stats.workers = R.workers;
+	stats.queue_waits = R.queueWaits;
+	stats.queue_wait_seconds = R.queueWaitSeconds;
+	stats.tiles_split = R.tilesSplit;
+	stats.tiles_filled = R.tilesFilled;
+	stats.tiles_calculated = R.tilesCalculated;
+	stats.cancelled = cancelled;
+	if (cancelled) {
+		chrono::high_resolution_clock::time_point cancelled_at;
+		if ( ! cancelTime(renderID, cancelled_at))
+			stats.cancel_latency = -1; //unknown
+		else if (cancelled_at > R.endTime)
+			stats.cancel_latency = 0; //cancelled after it had ended, just before the check above
+		else
+			stats.cancel_latency = chrono::duration<double>(R.endTime - cancelled_at).count();
+	}
+	stats.buffer_bytes = bufferPool.allocatedBytes();
+	stats.peak_buffer_bytes = bufferPool.peakBytes();
+	lastRenderStatistics = stats;
 
-	auto makeFrame = [&](int frame, bool recalculate) {
-		if (frame <= skipframes) {
-			cout << "skipping frame " << frame << endl;
-			return;
-		}
+	if ( ! stats_json_file.empty())
+		logRenderStatistics(stats, renderID, voidPtr(), mP.get_procedure().name(), render_algorithm_name(R.algorithm), use_avx, julia, width, height);
+}
 
-		std::stringstream num;
-		num << std::setfill('0') << std::setw(6); //numbering 000001, 000002, 000003, ...
-		num << frame;
 
-		if (save_only_parameters) {
-			string filename = "frame" + num.str() + ".efp";
-			writeParameters(canvas.P(), path + filename);
-			return;
-		}
 
-		if (recalculate)
-			canvas.createNewRender(); //the whole render takes place in this thread so after this the render is done
-		else
-			canvas.createNewBitmapRender(false);
+struct AnimationFrame {
+	int number;
+	FractalParameters P;
+	bool recalculate; //false if the iteration data of the frame before can be used
+	bool zoom_only; //true if the frame is part of a zoom to the center of the frame, so that only the zoom level differs from the frames before and after it
+	bool skip{ false }; //true if the frame is not rendered, see FrameSelection
+	FractalParameters calculated; //the parameters that the iteration data is calculated with: P, or for a frame that isn't recalculated, those of the last frame that is
+};
 
-		string filename = "frame" + num.str() + ".png";
-		cout << "saving image " << filename << endl;
-		saveImage(&canvas, path + filename, false);
+//The parameters of all frames of the animation of P, in order.
+vector<AnimationFrame> animationFrames(FractalParameters P, int framesPerInflection, int framesPerZoom)
+{
+	vector<AnimationFrame> frames;
+	auto addFrame = [&](bool recalculate, bool zoom_only = false) {
+		frames.push_back({ (int)frames.size() + 1, P, recalculate, zoom_only, false, recalculate ? P : frames.back().calculated });
 	};
 
-
 	P.setPreTransformation(7);
 	vector<double_c> inflections = P.get_inflectionCoords();
 	int inflectionCount = P.get_inflectionCount();
@@ -157,9 +183,7 @@ void animation(
 	P.setPartialInflectionCoord(0);
 
 	double inflectionPowerStepsize = 1.0 / (framesPerInflection - 1);
-	int frame = 1;
-
-	makeFrame(frame++, true);		
+	addFrame(true);		
 
 	double_c centerTarget = inflectionCount > 0 ? inflections[0] : originalCenter;
 	double_c currentCenter = P.get_center();
@@ -171,7 +195,7 @@ void animation(
 
 			P.setCenter( currentCenter + diff * ((1.0 / framesPerInflection) * i) );
 
-			makeFrame(frame++, true);
+			addFrame(true);
 		}
 	}
 	P.setCenter(centerTarget);
@@ -187,7 +211,7 @@ void animation(
 
 			P.setZoomLevel( currentZoom + zoomStepsize * i );
 
-			makeFrame(frame++, true);
+			addFrame(true, true);
 		}
 	}
 
@@ -214,7 +238,7 @@ void animation(
 			P.setCenterAndZoomAbsolute(0, zoom);
 			P.setCenter( currentCenter + diff * ((1.0 / (framesPerInflection-1)) * i) );
 
-			makeFrame(frame++, true);
+			addFrame(true);
 
 			P.setPartialInflectionPower( P.get_partialInflectionPower() + inflectionPowerStepsize);
 		}
@@ -223,9 +247,442 @@ void animation(
 
 	//repeat the last frame
 	for (int i=0; i<framesPerInflection; i++)
-		makeFrame(frame++, false);
+		addFrame(false);
+
+	return frames;
+}
+
+/*
+	Renders frame on c. If recalculate is false, the iteration data that c has is colored again. The statistics include the time for coloring.
+	A frame that isn't recalculated normally can still need to be, when the frame before it wasn't rendered (see FrameSelection). Then it's calculated with the parameters of the frame that it gets its iteration data from and colored with its own parameters, which gives the same image.
+*/
+RenderStatistics renderFrame(FractalCanvas& c, const AnimationFrame& frame, bool recalculate)
+{
+	auto start = chrono::high_resolution_clock::now();
+	RenderStatistics stats;
+	if (recalculate) {
+		c.changeParameters(frame.calculated);
+		c.createNewRender(); //the whole render takes place in this thread so after this the render is done
+		stats = c.lastRenderStatistics;
+	}
+	else {
+		stats.points = (uint64)c.P().width_canvas() * c.P().height_canvas();
+	}
+	if ( ! frame.recalculate) {
+		c.changeParameters(frame.P);
+		c.createNewBitmapRender(false);
+	}
+	chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+	stats.seconds = elapsed.count();
+	return stats;
+}
+
+/*
+	Renders the frames on parallel_frames canvases at the same time. Every canvas uses a part of the threads. That's faster for small frames, because the render of one small frame spends a large part of the time in starting threads and in the last part of the render, in which few threads have something to do.
+
+	The frames are output in order: a canvas with a finished frame waits until the frames before it have been output.
+*/
+void renderFramesInParallel(
+	const vector<AnimationFrame>& frames
+	,uint parallel_frames
+	,FractalCanvas& canvas
+	,std::function<void(const AnimationFrame&, FractalCanvas&, const RenderStatistics&)> outputFrame
+) {
+	uint threads_per_frame = max(1u, canvas.number_of_threads / parallel_frames);
+	cout << "rendering " << parallel_frames << " frames at the same time with " << threads_per_frame << " threads each" << endl;
+
+	vector<unique_ptr<FractalCanvas>> canvases;
+	for (uint i=0; i<parallel_frames; i++) {
+		canvases.push_back(make_unique<FractalCanvas>(threads_per_frame, make_shared<SimpleBitmapManager>()));
+		canvases.back()->render_algorithm = canvas.render_algorithm;
+	}
+
+	//The frames that don't need to be recalculated are at the end. They use the iteration data of the last calculated frame, so they're done after the others.
+	size_t calculated_frames = 0;
+	while (calculated_frames < frames.size() && frames[calculated_frames].recalculate)
+		calculated_frames++;
+
+	atomic<size_t> next_frame{ 0 };
+	size_t next_output = 0;
+	mutex outputMutex;
+	condition_variable outputTurn;
+	FractalCanvas* lastCanvas = nullptr; //the canvas that rendered the last calculated frame
+
+	auto renderFrames = [&](FractalCanvas* c) {
+		for (size_t i = next_frame++; i < calculated_frames; i = next_frame++)
+		{
+			const AnimationFrame& frame = frames[i];
+			RenderStatistics stats;
+			if ( ! frame.skip)
+				stats = renderFrame(*c, frame, true);
+
+			unique_lock<mutex> lock(outputMutex);
+			outputTurn.wait(lock, [&]{ return next_output == i; });
+			if ( ! frame.skip) {
+				outputFrame(frame, *c, stats);
+				if (i == calculated_frames - 1)
+					lastCanvas = c;
+			}
+			next_output++;
+			outputTurn.notify_all();
+		}
+	};
+	vector<thread> threads;
+	for (uint i=1; i<parallel_frames; i++)
+		threads.push_back(thread(renderFrames, canvases[i].get()));
+	renderFrames(canvases[0].get());
+	for (thread& t : threads)
+		t.join();
+
+	for (size_t i = calculated_frames; i < frames.size(); i++)
+	{
+		const AnimationFrame& frame = frames[i];
+		if (frame.skip)
+			continue;
+		FractalCanvas& c = lastCanvas != nullptr ? *lastCanvas : *canvases[0];
+		RenderStatistics stats = renderFrame(c, frame, lastCanvas == nullptr);
+		lastCanvas = &c;
+		outputFrame(frame, c, stats);
+	}
+}
+
+/*
+	Renders the frames of a zoom from one exponential map instead of rendering every frame. Consecutive frames of a zoom have most of their points in common, so this needs much fewer iterations, especially for long zooms.
+	This is an approximation. Every pixel of a frame is interpolated between 4 points of the map, which are not at the position of the pixel, so where the colors change quickly (at filaments and at the edges of the color bands) the frame is different from a rendered frame. In a zoom of 12 levels into the filaments near -0.7436+0.1318i at 160x100 with oversampling 2, 12 to 60 percent of the pixels of a frame were different (23 percent in the median frame), and 2 to 27 percent differed by more than 32 color levels. That's why it's only used with --approximate-zoom.
+
+	The exponential map (or log-polar map) is a rectangle in which the horizontal direction is the logarithm of the distance to the center of the zoom and the vertical direction is the angle around it. Pre-transformation 8 does that mapping. Every frame is a part of the map: a zoom by a factor 2 is a horizontal shift by log(2). The resolution of the map is chosen so that its points are at most as far apart as the pixels of the frames, also at the corners of the frames, where the angular distance between the points is the largest.
+
+	The frames should have the same center, size and rotation and no pre-transformation or an ineffective one. Returns false if the map can't be rendered, for example because it's larger than MAXIMUM_BITMAP_SIZE. Then the frames have to be rendered in the normal way.
+*/
+bool renderZoomFrames(
+	const vector<AnimationFrame>& frames
+	,FractalCanvas& canvas
+	,std::function<void(const AnimationFrame&, const ARGB*, const RenderStatistics&)> outputFrame
+) {
+	if (all_of(frames.begin(), frames.end(), [](const AnimationFrame& frame) { return frame.skip; }))
+		return true;
+
+	const FractalParameters& first = frames.front().P;
+	uint width = first.width_resolution();
+	uint height = first.height_resolution();
+	uint oversampling = first.get_oversampling();
+
+	//the distances from the center in pixels, for the smallest and largest radius that the frames need
+	double half_diagonal = sqrt((double)width * width + (double)height * height) / 2 + 1;
+	double smallest_radius = 0.5;
+
+	double largest_range = 0, smallest_range = numeric_limits<double>::max();
+	for (const AnimationFrame& frame : frames) {
+		largest_range = max(largest_range, frame.P.get_x_range());
+		smallest_range = min(smallest_range, frame.P.get_x_range());
+	}
+	double log_minimum = log(smallest_range / width * smallest_radius);
+	double log_maximum = log(largest_range / width * half_diagonal);
+
+	//the size of the map in pixels: the angular distance between points at the corner of a frame is at most one pixel, and the pixels of the map are square
+	uint map_height = (uint)ceil(2 * pi * half_diagonal);
+	double map_spacing = 2 * pi / map_height;
+	uint map_width = (uint)ceil((log_maximum - log_minimum) / map_spacing) + 2;
+
+	//A long zoom of large frames needs a very large map. It's only rendered if its iteration data (counts and flags for oversampling^2 points per pixel) and its bitmap together fit in MAXIMUM_BITMAP_SIZE bytes.
+	uint64 map_points = (uint64)map_width * map_height * oversampling * oversampling;
+	uint64 count_size = first.get_maxIters() > UINT16_MAX ? sizeof(uint32) : sizeof(uint16);
+	uint64 map_bytes = map_points * count_size + map_points / 4 + (uint64)map_width * map_height * sizeof(ARGB);
+	if (map_bytes > MAXIMUM_BITMAP_SIZE) {
+		cout << "The exponential map of " << map_width << "x" << map_height << " pixels would need " << map_bytes << " bytes, which is too much. The frames are rendered one by one." << endl;
+		return false;
+	}
+	cout << "rendering the zoom of " << frames.size() << " frames from an exponential map of " << map_width << "x" << map_height << " pixels" << endl;
+
+	FractalCanvas map(canvas.number_of_threads, make_shared<SimpleBitmapManager>());
+	map.render_algorithm = canvas.render_algorithm;
+	ResizeResult res = map.changeParameters([&](FractalParameters& P) {
+		P.fromParameters(first);
+		P.setRotation(0);
+		P.resize(map_width, map_height, oversampling, 1);
+		P.setPreTransformation(8);
+		P.setPartialInflectionCoord(first.get_center());
+		double x_range = map_width * map_spacing;
+		P.setCenterAndZoomAbsolute((log_minimum - map_spacing + x_range / 2) + pi*I, 2 - log2(x_range));
+	});
+	if ( ! res.success) {
+		cout << "The exponential map can't be rendered. The frames are rendered one by one." << endl;
+		return false;
+	}
+	map.createNewRender();
+	RenderStatistics map_stats = map.lastRenderStatistics; //added to the first frame
+
+	const FractalParameters& mapP = map.P();
+	const ARGB* mapPixels = &map.ptPixels[map.pixelIndex_of_pixelXY(0, 0)];
+	double left = real(mapP.get_topleftCorner());
+	double top = imag(mapP.get_topleftCorner());
+	double x_spacing = mapP.get_x_spacing();
+	double y_spacing = mapP.get_y_spacing();
+	double pixel_center = (oversampling - 1) / 2.0; //the position of the center of a pixel among its points
+	double rotation = 2 * pi * first.get_rotation_angle();
+
+	//The logarithm of the distance to the center and the angle of every pixel of the frames, in pixels. This is the same for all frames. Only the distance is scaled by the zoom.
+	vector<double> log_distance((size_t)width * height);
+	vector<double> angle((size_t)width * height);
+	for (uint y=0; y<height; y++)
+	for (uint x=0; x<width; x++) {
+		double_c offset = (x + pixel_center / oversampling - width / 2.0) + (height / 2.0 - y - pixel_center / oversampling) * I;
+		size_t i = (size_t)y * width + x;
+		log_distance[i] = log(max(abs(offset), 1e-9));
+		angle[i] = arg(offset) + rotation;
+	}
+
+	vector<ARGB> pixels((size_t)width * height);
+	double log_pixel_size;
+
+	//the pixels of the frame in the rows from ymin to ymax
+	auto resampleRows = [&](uint ymin, uint ymax) {
+		for (size_t i = (size_t)ymin * width; i < (size_t)ymax * width; i++)
+		{
+			//the position in the map in pixels of the map
+			double mx = (log_distance[i] + log_pixel_size - left) / x_spacing;
+			double my = (top - angle[i]) / y_spacing;
+			mx = (mx - pixel_center) / oversampling;
+			my = (my - pixel_center) / oversampling;
+			mx = min(max(mx, 0.0), (double)(map_width - 1));
+			my = fmod(my, (double)map_height);
+			if (my < 0)
+				my += map_height;
+
+			//bilinear interpolation, where the angle wraps around
+			uint x0 = min((uint)mx, map_width - 1);
+			uint y0 = min((uint)my, map_height - 1);
+			uint x1 = min(x0 + 1, map_width - 1);
+			uint y1 = (y0 + 1) % map_height;
+			double fx = mx - x0;
+			double fy = my - y0;
+			const ARGB& c00 = mapPixels[(size_t)y0 * map_width + x0];
+			const ARGB& c10 = mapPixels[(size_t)y0 * map_width + x1];
+			const ARGB& c01 = mapPixels[(size_t)y1 * map_width + x0];
+			const ARGB& c11 = mapPixels[(size_t)y1 * map_width + x1];
+			auto mix = [&](uint8 a, uint8 b, uint8 c, uint8 d) {
+				double top_row = a + (b - a) * fx;
+				double bottom_row = c + (d - c) * fx;
+				return (uint8)(top_row + (bottom_row - top_row) * fy + 0.5);
+			};
+			pixels[i] = rgb(mix(c00.R, c10.R, c01.R, c11.R), mix(c00.G, c10.G, c01.G, c11.G), mix(c00.B, c10.B, c01.B, c11.B));
+		}
+	};
+
+	uint usingThreads = min(map.number_of_threads, height);
+	for (const AnimationFrame& frame : frames)
+	{
+		if (frame.skip)
+			continue;
+		auto start = chrono::high_resolution_clock::now();
+		log_pixel_size = log(frame.P.get_x_range() / width);
+
+		//every thread does a band of rows
+		vector<thread> threads;
+		for (uint k=1; k<usingThreads; k++)
+			threads.push_back(thread(resampleRows, (uint64)height * k / usingThreads, (uint64)height * (k + 1) / usingThreads));
+		resampleRows(0, height / usingThreads);
+		for (thread& t : threads)
+			t.join();
+
+		chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+		RenderStatistics stats = map_stats;
+		stats.seconds += elapsed.count();
+		map_stats = RenderStatistics();
+		outputFrame(frame, pixels.data(), stats);
+	}
+	return true;
+}
+
+void animation(
+	string path
+	,bool save_only_parameters
+	,FrameSelection selection
+	,int framesPerInflection
+	,int framesPerZoom
+	,FractalCanvas& canvas
+	,FrameStreamWriter* stream = nullptr //if not nullptr, the frames are written to this instead of PNG files
+	,uint parallel_frames = 1 //the number of frames that are rendered at the same time
+	,bool approximate_zoom = false //if true, the frames of the zoom are interpolated from one exponential map, see renderZoomFrames
+) {
+	vector<AnimationFrame> frames = animationFrames(canvas.P(), framesPerInflection, framesPerZoom);
+	ImageSaveQueue saveQueue(canvas.number_of_threads); //saves the PNG files while the next frame renders
+
+	auto frameName = [](int number, string extension) {
+		std::stringstream num;
+		num << std::setfill('0') << std::setw(6); //numbering 000001, 000002, 000003, ...
+		num << number;
+		return "frame" + num.str() + extension;
+	};
+
+	//The PNG files that are saved are recorded in the manifest. Those that are in it already are not rendered again.
+	bool use_manifest = ! save_only_parameters && stream == nullptr;
+	FrameManifest manifest(path);
+	vector<uint> parameters_checksums(frames.size());
+	int selected = 0, completed = 0;
+	for (size_t i=0; i<frames.size(); i++)
+	{
+		AnimationFrame& frame = frames[i];
+		frame.skip = ! selection.contains(frame.number);
+		if ( ! frame.skip && use_manifest) {
+			parameters_checksums[i] = parametersChecksum(frame.P);
+			if (manifest.isCompleted(frameName(frame.number, ".png"), parameters_checksums[i], selection.verify_completed)) {
+				frame.skip = true;
+				completed++;
+			}
+		}
+		if ( ! frame.skip)
+			selected++;
+	}
+	cout << "rendering " << selected << " of " << frames.size() << " frames";
+	if (completed > 0)
+		cout << " (" << completed << " frames were completed already)";
+	cout << endl;
+
+	//Every frame that's saved or streamed is logged with its statistics. The stream can write the last frames after this function is done, so the log is shared with the callbacks.
+	auto log = make_shared<AnimationLog>(path + "frames.jsonl", selected);
+
+	auto outputPixels = [&](const AnimationFrame& frame, const ARGB* pixels, const RenderStatistics& stats) {
+		int number = frame.number;
+		if (stream != nullptr) {
+			cout << "streaming frame " << number << endl;
+			stream->addFrame(pixels, [log, number, stats](double seconds) {
+				log->frameFinished(number, stats, seconds);
+			});
+			return;
+		}
+		string filename = frameName(number, ".png");
+		cout << "saving image " << filename << endl;
+		uint parameters_checksum = parameters_checksums[number - 1];
+		saveQueue.addImage(pixels, frame.P.width_resolution(), frame.P.height_resolution(), path + filename, [&manifest, log, filename, number, parameters_checksum, stats](uint checksum, double seconds) {
+			manifest.add(filename, parameters_checksum, checksum);
+			log->frameFinished(number, stats, seconds);
+		});
+	};
+	auto outputFrame = [&](const AnimationFrame& frame, FractalCanvas& c, const RenderStatistics& stats) {
+		outputPixels(frame, &c.ptPixels[c.pixelIndex_of_pixelXY(0, 0)], stats);
+	};
+
+	//renders the frames in the normal way
+	auto renderFrames = [&](const vector<AnimationFrame>& part) {
+		if (parallel_frames > 1) {
+			renderFramesInParallel(part, min<uint>(parallel_frames, max<size_t>(1, part.size())), canvas, outputFrame);
+			return;
+		}
+		bool rendered = false; //whether the canvas has the iteration data of the frame before
+		for (const AnimationFrame& frame : part)
+		{
+			if (frame.skip) {
+				//A skipped frame that doesn't need to be recalculated has the same iteration data as the frame before it.
+				rendered = rendered && ! frame.recalculate;
+				continue;
+			}
+			RenderStatistics stats = renderFrame(canvas, frame, frame.recalculate || ! rendered);
+			rendered = true;
+			outputFrame(frame, canvas, stats);
+		}
+	};
+
+	if (save_only_parameters)
+	{
+		for (const AnimationFrame& frame : frames)
+		{
+			if (frame.skip)
+				continue;
+			writeParameters(frame.P, path + frameName(frame.number, ".efp"));
+		}
+	}
+	else if ( ! approximate_zoom) {
+		renderFrames(frames);
+	}
+	else {
+		//The frames of the zoom are interpolated from an exponential map. The other frames are rendered normally.
+		for (size_t begin = 0; begin < frames.size(); )
+		{
+			size_t end = begin;
+			while (end < frames.size() && frames[end].zoom_only == frames[begin].zoom_only)
+				end++;
+			vector<AnimationFrame> part(frames.begin() + begin, frames.begin() + end);
+			if ( ! part.front().zoom_only || ! renderZoomFrames(part, canvas, outputPixels))
+				renderFrames(part);
+			begin = end;
+		}
+	}
 
-	P.setPreTransformation(0);
+	if ( ! saveQueue.finish())
+		cout << "not all frames could be saved" << endl;
+
+	//end with the parameters of the last frame, also when the frames were rendered on other canvases
+	if ( ! frames.empty())
+		canvas.changeParameters(frames.back().P);
+	canvas.Pmutable().setPreTransformation(0);
+}
+
+//The parameter files of a batch: the .efp files in the directory name, or the files in the text file name with one file per line
+vector<string> batchFiles(string name)
+{
+	vector<string> files;
+	error_code error;
+	if (filesystem::is_directory(name, error)) {
+		for (const filesystem::directory_entry& entry : filesystem::directory_iterator(name, error)) {
+			if (entry.is_regular_file(error) && entry.path().extension() == ".efp")
+				files.push_back(entry.path().string());
+		}
+		sort(files.begin(), files.end()); //the directory can be in any order
+		return files;
+	}
+	ifstream list(name);
+	if ( ! list.is_open()) {
+		cout << "could not open the batch list " << name << endl;
+		return files;
+	}
+	string line;
+	while (getline(list, line)) {
+		while ( ! line.empty() && (line.back() == '\r' || line.back() == ' ')) //for lists made on Windows
+			line.pop_back();
+		if ( ! line.empty())
+			files.push_back(line);
+	}
+	return files;
+}
+
+/*
+	Renders every parameter file to an image in one process, instead of starting the program once for every file. All images are rendered with the same canvas, so the memory of the canvas is used again when the size stays the same, and the PNG file of an image is saved while the next one renders.
+
+	The images are named after the parameter files, like with --image. overrideSize is applied to the parameters of every file, for the command line options that change the size. Returns false if some file couldn't be rendered or saved.
+*/
+bool renderBatch(const vector<string>& files, string path, FractalCanvas& canvas, std::function<void(FractalParameters&)> overrideSize, bool save_iteration_data)
+{
+	ImageSaveQueue saveQueue(canvas.number_of_threads);
+	bool success = true;
+	auto start = chrono::high_resolution_clock::now();
+
+	for (size_t i=0; i<files.size(); i++)
+	{
+		FractalParameters P;
+		if (readParametersFile(P, files[i]) != ReadResult::succes) {
+			cout << "could not read the parameter file " << files[i] << endl;
+			success = false;
+			continue;
+		}
+		overrideSize(P);
+
+		string name = filesystem::path(files[i]).filename().string();
+		cout << "rendering image " << i+1 << " / " << files.size() << ": " << files[i] << endl;
+		canvas.changeParameters(P);
+		canvas.createNewRender(); //the whole render takes place in this thread
+		if(debug) cout << "render took " << canvas.lastRenderStatistics.seconds << " seconds" << endl;
+
+		saveQueue.addImage(canvas, path + name + ".png");
+		if (save_iteration_data && ! saveIterationData(canvas, path + name + ".efi"))
+			success = false;
+	}
+	if ( ! saveQueue.finish())
+		success = false;
+
+	chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+	cout << "rendered " << files.size() << " parameter files in " << durationString(elapsed.count()) << endl;
+	return success;
 }
 
 
@@ -239,8 +696,23 @@ string parameterfile = "default.efp";
 int fps = 60;
 double secondsPerInflection = 3;
 double secondsPerZoom = 0.6666666666666;
-int skipframes = 0;
+FrameSelection frame_selection;
 bool save_as_efp = false;
+RenderAlgorithm render_algorithm = RenderAlgorithm::MarianiSilver;
+uint band_height = 0; //0 means that the image is rendered at once
+bool stream_frames = false;
+FrameFormat stream_format = FrameFormat::Y4M_420;
+string stream_file = "-"; //stdout
+bool save_iteration_data = false;
+string iteration_data_file = ""; //if not empty, the image is colored from this file instead of rendered
+uint parallel_frames = 1;
+bool approximate_zoom = false;
+string batch_list = ""; //if not empty, the parameter files in this directory or list are rendered to images
+bool benchmark = false;
+bool kernel_benchmark = false;
+string benchmark_filter = "";
+string benchmark_baseline = "";
+string benchmark_save = "";
 
 
 [[gnu::target("avx")]]
@@ -250,6 +722,20 @@ uint64 getFeatureMask() {
 
 int main(int argc, char *argv[])
 {
+	{
+		//When animation frames are streamed to stdout, all text output goes to stderr. That has to be decided before the first output.
+		bool stream = false;
+		bool to_stdout = true;
+		for (int i=1; i<argc; i++) {
+			if (string(argv[i]) == "--stream")
+				stream = true;
+			if (string(argv[i]) == "--stream-file" && i+1 < argc && string(argv[i+1]) != "-")
+				to_stdout = false;
+		}
+		if (stream && to_stdout)
+			cout.rdbuf(cerr.rdbuf());
+	}
+
 	//unit tests:
 	testfunction();
 
@@ -263,6 +749,7 @@ int main(int argc, char *argv[])
 	}
 	
 	bool override_interactive = false;
+	bool override_parameterfile = false;
 	int override_width = -1;
 	int override_height = -1;
 	int override_oversampling = -1;
@@ -297,9 +784,48 @@ int main(int argc, char *argv[])
 		}
 		else if (c == "--skipframes" ) {
 			if (i+1 < argc) {
-				skipframes = stoi(commands[i+1]);
+				frame_selection.skipframes = stoi(commands[i+1]);
+			}
+		}
+		else if (c == "--frames") {
+			//a-b, a- or a
+			if (i+1 < argc) {
+				string range = commands[i+1];
+				size_t dash = range.find('-');
+				frame_selection.first = stoi(range.substr(0, dash));
+				if (dash == string::npos)
+					frame_selection.last = frame_selection.first;
+				else if (dash + 1 < range.size())
+					frame_selection.last = stoi(range.substr(dash + 1));
+			}
+		}
+		else if (c == "--verify-frames") {
+			frame_selection.verify_completed = true;
+		}
+		else if (c == "--shard") {
+			//k/n
+			if (i+1 < argc) {
+				string shard = commands[i+1];
+				size_t slash = shard.find('/');
+				int k = stoi(shard.substr(0, slash));
+				int n = slash == string::npos ? 0 : stoi(shard.substr(slash + 1));
+				if (n >= 1 && k >= 1 && k <= n) {
+					frame_selection.shard = k;
+					frame_selection.shard_count = n;
+				}
+				else {
+					cout << "invalid shard " << shard << ", use k/n with 1 <= k <= n" << endl;
+				}
+			}
+		}
+		else if (c == "--parallel-frames") {
+			if (i+1 < argc) {
+				parallel_frames = max(1, stoi(commands[i+1]));
 			}
 		}
+		else if (c == "--approximate-zoom") {
+			approximate_zoom = true;
+		}
 		else if (c == "--efp") {
 			save_as_efp = true;
 		}
@@ -324,6 +850,51 @@ int main(int argc, char *argv[])
 				override_oversampling = stoi(commands[i+1]);
 			}
 		}
+		else if (c == "--algorithm") {
+			if (i+1 < argc) {
+				if (commands[i+1] == "silver")
+					render_algorithm = RenderAlgorithm::MarianiSilver;
+				else if (commands[i+1] == "boundary")
+					render_algorithm = RenderAlgorithm::BoundaryTracing;
+				else
+					cout << "unknown algorithm: " << commands[i+1] << endl;
+			}
+		}
+		else if (c == "--layout") {
+			if (i+1 < argc) {
+				if (commands[i+1] == "pixel")
+					using_blocked_layout = false;
+				else if (commands[i+1] == "blocked")
+					using_blocked_layout = true;
+				else
+					cout << "unknown layout: " << commands[i+1] << endl;
+			}
+		}
+		else if (c == "--band-height") {
+			if (i+1 < argc) {
+				band_height = stoi(commands[i+1]);
+			}
+		}
+		else if (c == "--stream") {
+			if (i+1 < argc) {
+				stream_frames = true;
+				if (commands[i+1] == "y4m")
+					stream_format = FrameFormat::Y4M_420;
+				else if (commands[i+1] == "y4m444")
+					stream_format = FrameFormat::Y4M_444;
+				else if (commands[i+1] == "ppm")
+					stream_format = FrameFormat::PPM;
+				else {
+					cout << "unknown stream format: " << commands[i+1] << endl;
+					stream_frames = false;
+				}
+			}
+		}
+		else if (c == "--stream-file") {
+			if (i+1 < argc) {
+				stream_file = commands[i+1];
+			}
+		}
 		else if (c == "-o") {
 			if (i+1 < argc) {
 				string s = commands[i+1];
@@ -336,6 +907,59 @@ int main(int argc, char *argv[])
 		else if (c == "-p") {
 			if (i+1 < argc) {
 				parameterfile = commands[i+1];
+				override_parameterfile = true;
+			}
+		}
+		else if (c == "--batch") {
+			if (i+1 < argc) {
+				batch_list = commands[i+1];
+				if (!override_interactive) {
+					interactive = false;
+				}
+			}
+		}
+		else if (c == "--benchmark") {
+			benchmark = true;
+			if (!override_interactive) {
+				interactive = false;
+			}
+		}
+		else if (c == "--kernel-benchmark") {
+			kernel_benchmark = true;
+			if (!override_interactive) {
+				interactive = false;
+			}
+		}
+		else if (c == "--benchmark-filter") {
+			if (i+1 < argc) {
+				benchmark_filter = commands[i+1];
+			}
+		}
+		else if (c == "--benchmark-baseline") {
+			if (i+1 < argc) {
+				benchmark_baseline = commands[i+1];
+			}
+		}
+		else if (c == "--benchmark-save") {
+			if (i+1 < argc) {
+				benchmark_save = commands[i+1];
+			}
+		}
+		else if (c == "--stats-json") {
+			if (i+1 < argc) {
+				stats_json_file = commands[i+1];
+			}
+		}
+		else if (c == "--save-iters") {
+			save_iteration_data = true;
+		}
+		else if (c == "--iters") {
+			if (i+1 < argc) {
+				iteration_data_file = commands[i+1];
+				render_image = true;
+				if (!override_interactive) {
+					interactive = false;
+				}
 			}
 		}
 		else if (c == "--help" || c == "-h") {
@@ -347,23 +971,53 @@ all available parameters:
     --height        override the height parameter
     --oversampling  override the oversampling parameter
     --image         render the initial parameter file to an image
-    --animation     render an animation of the initial parameters
+    --animation     render an animation of the initial parameters. The saved frames are listed in frames.manifest in the output directory, and rendering the same animation again skips them. frames.jsonl gets a line with the render time, encode time and iteration counts of every frame.
     --efp           save the parameters instead of rendering to an image (can be used to convert old parameter files or to store parameter files for every frame in an animation)
     --fps number    the number of frames per second (integer)
     --spi number    the number of seconds per inflection (floating point)
     --spz number    the number of seconds per zoom (floating point)
     --skipframes    number of frames to skip (for example to continue an unfinished animation render)
+    --frames a-b    render only the frames a to b of the animation. a- means from a to the end.
+    --shard k/n     render only every n-th frame of the animation, starting with frame k. With n processes with k = 1 to n, all frames are rendered once.
+    --verify-frames  read the frames that frames.manifest lists as completed to check their checksums. Without this only their sizes are checked.
+    --parallel-frames number  render this many frames of the animation at the same time, each with a part of the threads. That's faster for small frames. default: 1
+    --approximate-zoom  interpolate the frames of the zoom in the animation from one exponential map instead of rendering every frame. This is much faster for long zooms, but the frames are not exact: in a zoom into a detailed area, 10 to 60 percent of the pixels of a frame differed from the rendered frame, many by a lot.
+    --algorithm name  the render algorithm: silver (Mariani-Silver, default) or boundary (boundary tracing, only used for the Mandelbrot procedures, the others use silver)
+    --layout name   the memory layout of the iteration data: blocked (default) or pixel
+    --band-height number  render the image in bands of this many rows of pixels and write the PNG file during the render, which uses much less memory for very large images
+    --stream format  write the frames of the animation as uncompressed video to stdout instead of PNG files. format: y4m (YUV 4:2:0), y4m444 (YUV 4:4:4) or ppm (RGB). The text output goes to stderr.
+    --stream-file name  write the stream to this file or FIFO instead of stdout
+    --stats-json name  append a line of JSON with the statistics of every render to the file name, or to stderr if name is -. That's the time of the parts of the render, how busy every thread was, the tiles and the memory. This works for renders in the GUI too.
+    --save-iters    also save the iteration data of the image (name.efp.efi), to be able to color it again later without rendering
+    --iters name.efi  save an image colored with the iteration data in name.efi instead of rendering it. With -p, the gradient of that parameter file is used.
+    --batch name    render all .efp files in the directory name, or all files listed in the text file name (one per line), to images in one process. That's faster than starting the program for every file. --width, --height, --oversampling and --save-iters apply to every file.
+    --benchmark     render a fixed set of views with every procedure, with and without AVX and with 1, 2, 4 etc. threads up to all threads, and show the speed in Miter/s and points per second, the part of the points that was guessed and how well the speed scales with the threads. --width, --height, --oversampling and --algorithm apply to every view.
+    --kernel-benchmark  calculate fixed sets of points (exterior, boundary and interior) with the calculations of every procedure with several values of maxIters, in one thread without the render algorithm, and show the cycles per iteration and how well the AVX lanes are used
+    --benchmark-filter text  benchmark only the views whose name contains text, for example "Mandelbrot power 2" or "julia". This works for --kernel-benchmark too, for example "avx" or "interior".
+    --benchmark-save name  save the benchmark results to the file name, to compare later results with
+    --benchmark-baseline name  compare the benchmark results with those saved in the file name. Results that are more than 10% slower are marked as a regression and the program exits with code 1.
     -i              do not close the program after rendering an image or animation to continue interactive use
     --help or -h    show this text
 
 examples:
     ExploreFractals -p file.efp --animation --fps 60 --spi 3 --spz 0.6666 -o C:\folder -i
     ExploreFractals -p name.efp --width 1920 --height 1080 --oversampling 2
+    ExploreFractals -p file.efp --animation --stream y4m | ffmpeg -i - video.mp4
+    ExploreFractals -p file.efp --animation --width 480 --height 270 --parallel-frames 4
+    ExploreFractals -p file.efp --animation --shard 1/2 -o C:\folder (and --shard 2/2 in another process)
+    ExploreFractals --iters name.efp.efi -p othercolors.efp --image
+    ExploreFractals --batch C:\parameters --width 1920 --height 1080 -o C:\images
+    ExploreFractals --benchmark --benchmark-save before.jsonl (and after a change: --benchmark --benchmark-baseline before.jsonl)
 )"			) << endl;
 			return 0;
 		}
 	}
 
+	if (save_iteration_data && band_height > 0) {
+		cout << "--save-iters can't be used with --band-height, because the iteration data of the whole image is never in memory at once" << endl;
+		return 0;
+	}
+
 	cout << "animation: " << (render_animation ? "yes" : "no") << endl;
 	cout << "initial parameters: " << parameterfile << endl;
 	cout << "override width, height, oversampling: "
@@ -389,59 +1043,127 @@ examples:
 	__cpuid(cpuInfo, 1);
 	bool osUsesXSAVE_XRSTORE = cpuInfo[2] & (1 << 27) || false;
 	bool cpuAVXSuport = cpuInfo[2] & (1 << 28) || false;
-	if (osUsesXSAVE_XRSTORE && cpuAVXSuport) {
+	bool osSavesYMM = false; //whether the operating system saves the YMM registers, which AVX and AVX2 both need
+	if (osUsesXSAVE_XRSTORE) {
 		uint64 xcrFeatureMask = getFeatureMask();
-		using_avx = (xcrFeatureMask & 0x6) == 0x6;
+		osSavesYMM = (xcrFeatureMask & 0x6) == 0x6;
 	}
+	using_avx = cpuAVXSuport && osSavesYMM;
 	cout << "using AVX: " << (using_avx ? "Yes" : "No") << endl;
 
+	__cpuid(cpuInfo, 0);
+	if (osSavesYMM && cpuInfo[0] >= 7) {
+		__cpuidex(cpuInfo, 7, 0);
+		bool cpuAVX2Support = (cpuInfo[1] & (1 << 5)) != 0;
+		using_avx2 = cpuAVX2Support && cpuAVXSuport;
+	}
+	cout << "using AVX2: " << (using_avx2 ? "Yes" : "No") << endl;
+
 
 	FractalParameters defaultParameters;
 
 	readParametersFile(defaultParameters, parameterfile);
-	{
+	auto overrideSize = [&](FractalParameters& P) {
 		int& o = override_oversampling, w = override_width, h = override_height;
 		if (o != -1 || w != -1 || h != -1)
-			defaultParameters.resize(
-				(w != -1 ? w : defaultParameters.get_target_width())
-				,(h != -1 ? h : defaultParameters.get_target_height())
-				,(o != -1 ? o : defaultParameters.get_oversampling())
-				,defaultParameters.get_bitmap_zoom()
+			P.resize(
+				(w != -1 ? w : P.get_target_width())
+				,(h != -1 ? h : P.get_target_height())
+				,(o != -1 ? o : P.get_oversampling())
+				,P.get_bitmap_zoom()
 			);
-	}
+	};
+	overrideSize(defaultParameters);
 
 	FractalParameters initialParameters = defaultParameters;
+	bool benchmark_regression = false;
 
-	if (save_as_efp && ! render_animation) {
+	if (kernel_benchmark) {
+		FractalCanvas canvas{ 1, make_shared<SimpleBitmapManager>() };
+		runKernelBenchmark(canvas, benchmark_filter);
+	}
+	else if (benchmark) {
+		FractalCanvas canvas{ NUMBER_OF_THREADS, make_shared<SimpleBitmapManager>() };
+		canvas.render_algorithm = render_algorithm;
+		benchmark_regression = ! runBenchmark(canvas, overrideSize, benchmark_filter, benchmark_baseline, benchmark_save);
+	}
+	else if ( ! batch_list.empty()) {
+		vector<string> files = batchFiles(batch_list);
+		cout << "rendering " << files.size() << " parameter files" << endl;
+		FractalCanvas canvas{ defaultParameters, NUMBER_OF_THREADS, make_shared<SimpleBitmapManager>(), {} };
+		canvas.render_algorithm = render_algorithm;
+		if ( ! renderBatch(files, write_directory, canvas, overrideSize, save_iteration_data))
+			cout << "not all parameter files could be rendered" << endl;
+	}
+	else if (save_as_efp && ! render_animation) {
 		writeParameters(defaultParameters, write_directory + parameterfile);
 	}
 	else if (render_image || render_animation)
 	{
-		FractalCanvas canvas{ defaultParameters, NUMBER_OF_THREADS, make_shared<SimpleBitmapManager>(), {} };
-
-		if (render_image)
-		{		
-			cout << "rendering image" << endl;
-			canvas.createNewRender();
-			saveImage(&canvas, write_directory + parameterfile + ".png");
+		if (render_image && band_height > 0 && iteration_data_file.empty())
+		{
+			//This doesn't need the canvas below, which would need the memory for the whole image.
+			cout << "rendering image in bands of " << band_height << " rows" << endl;
+			renderImageInBands(defaultParameters, band_height, render_algorithm, NUMBER_OF_THREADS, write_directory + parameterfile + ".png");
+			render_image = false;
 		}
-		if (render_animation)
+		if (render_image || render_animation)
 		{
-			int framesPerInflection = (int)(fps * secondsPerInflection);
-			int framesPerZoom = (int)(fps * secondsPerZoom);
-			cout << "rendering animation with" << endl;
-			cout << fps << " fps" << endl;
-			cout << framesPerInflection << " frames per inflection" << endl;
-			cout << framesPerZoom << " frames per zoom" << endl;
-			animation(write_directory, save_as_efp, skipframes, framesPerInflection, framesPerZoom, canvas);
-
-			//this causes the parameters of the final frame of the animation to be used in the first tab if interactive is true
-			initialParameters.fromParameters(canvas.P());
+			FractalCanvas canvas{ defaultParameters, NUMBER_OF_THREADS, make_shared<SimpleBitmapManager>(), {} };
+			canvas.render_algorithm = render_algorithm;
+
+			if (render_image && ! iteration_data_file.empty())
+			{
+				string name = override_parameterfile ? parameterfile : iteration_data_file;
+				if (loadIterationData(canvas, iteration_data_file))
+				{
+					if (override_parameterfile) {
+						canvas.changeParameters([&](FractalParameters& P) {
+							P.setGradientColors(defaultParameters.get_gradientColors());
+							P.setGradientSpeed(defaultParameters.get_gradientSpeed());
+							P.setGradientOffset(defaultParameters.get_gradientOffset());
+						});
+					}
+					cout << "coloring image" << endl;
+					canvas.createNewBitmapRender(false);
+					saveImage(&canvas, write_directory + name + ".png");
+				}
+			}
+			else if (render_image)
+			{		
+				cout << "rendering image" << endl;
+				canvas.createNewRender();
+				saveImage(&canvas, write_directory + parameterfile + ".png");
+				if (save_iteration_data)
+					saveIterationData(canvas, write_directory + parameterfile + ".efi");
+			}
+			if (render_animation)
+			{
+				int framesPerInflection = (int)(fps * secondsPerInflection);
+				int framesPerZoom = (int)(fps * secondsPerZoom);
+				cout << "rendering animation with" << endl;
+				cout << fps << " fps" << endl;
+				cout << framesPerInflection << " frames per inflection" << endl;
+				cout << framesPerZoom << " frames per zoom" << endl;
+				if (stream_frames && ! save_as_efp) {
+					FrameStreamWriter stream(stream_file, stream_format, canvas.P().width_resolution(), canvas.P().height_resolution(), fps);
+					if (stream.good()) {
+						animation(write_directory, save_as_efp, frame_selection, framesPerInflection, framesPerZoom, canvas, &stream, parallel_frames, approximate_zoom);
+					}
+					stream.finish();
+				}
+				else {
+					animation(write_directory, save_as_efp, frame_selection, framesPerInflection, framesPerZoom, canvas, nullptr, parallel_frames, approximate_zoom);
+				}
+
+				//this causes the parameters of the final frame of the animation to be used in the first tab if interactive is true
+				initialParameters.fromParameters(canvas.P());
+			}
 		}
 	}
 
 	if (!interactive) {
-		return 0;
+		return benchmark_regression ? 1 : 0;
 	}
 	// This closes the automatically openened console window. This program needs to be a commandline program because it has commandline parameters that can be used and it gives text output. Windows opens a console window for every console program and I don't want that window. Unfortunately a windows program can't be both a commandline and a GUI program. Previously I used this to close the window:
 	//ShowWindow(GetConsoleWindow(), SW_HIDE);
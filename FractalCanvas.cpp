@@ -22,23 +22,95 @@
 //standard library
 #include <algorithm>
 #include <functional>
-
-//lodepng
-#include "lodepng/lodepng.cpp"
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <immintrin.h>
 
 //this program
 #include "common.cpp"
 #include "FractalParameters.cpp"
+#include "utilities.cpp"
 
 constexpr uint64 MAXIMUM_BITMAP_SIZE = 2147483648; // 2^31
 
-// dontdo: make this a template? to allow larger iterationcounts, and therefore increased memory, but only when necessary
-class IterData {
-public:
-	uint iterationCount : 30;
-	bool guessed : 1;
-	bool inMinibrot : 1;
+/*
+	The iteration data of one point. FractalCanvas doesn't store it like this. It has separate arrays for the counts and the flags, see iterationCounts.
+*/
+struct IterData {
+	uint iterationCount;
+	bool guessed;
+	bool inMinibrot;
 };
+//the bits of a point in FractalCanvas::iterationFlags
+constexpr uint8 FLAG_GUESSED = 1;
+constexpr uint8 FLAG_IN_MINIBROT = 2;
+
+/*
+	Whether the iteration counts need 32 bits. 16 bits are enough for most renders.
+	Some procedures have counts that can be larger than maxIters: the count of Recursive Fractal is the count of the Mandelbrot iteration plus that of the Julia iteration after it, so at most 2*maxIters, and the count of Triple Matchmaker is a sum that's usually larger than maxIters, so that always needs 32 bits.
+*/
+inline bool needs_wide_counts(const FractalParameters& P) {
+	uint64 largest_count = P.get_maxIters();
+	if (P.get_procedure().id == RECURSIVE_FRACTAL.id)
+		largest_count = 2 * largest_count;
+	return largest_count > UINT16_MAX || P.get_procedure().id == TRIPLE_MATCHMAKER.id;
+}
+
+/*
+	Checks if count values, starting at start and each stride values apart, are all equal to value.
+	count_t is the type of the iteration counts: uint16 or uint32.
+*/
+template <typename count_t>
+[[gnu::target("avx2")]]
+inline bool isSameRun_avx2(const count_t* start, uint count, uint stride, uint value)
+{
+	static_assert(sizeof(count_t) == 2 || sizeof(count_t) == 4);
+	uint i = 0;
+	if (stride == 1) {
+		//contiguous values: compare 32 bytes at a time, which is 16 counts of 16 bits or 8 of 32 bits
+		constexpr uint per_vector = 32 / sizeof(count_t);
+		const __m256i expected = sizeof(count_t) == 2 ? _mm256_set1_epi16(value) : _mm256_set1_epi32(value);
+		for (; i + per_vector <= count; i += per_vector) {
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(start + i));
+			__m256i equal = sizeof(count_t) == 2 ? _mm256_cmpeq_epi16(v, expected) : _mm256_cmpeq_epi32(v, expected);
+			if (_mm256_movemask_epi8(equal) != -1)
+				return false;
+		}
+	}
+	else {
+		//There's no gather instruction for 16-bit values. They're gathered as 32-bit values and the upper half is masked away. The allocation of the counts is padded so that this doesn't read past the end.
+		const __m256i mask = _mm256_set1_epi32(sizeof(count_t) == 2 ? 0xFFFF : 0xFFFFFFFF);
+		const __m256i expected = _mm256_set1_epi32(value);
+		const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+		for (; i + 8 <= count; i += 8) {
+			__m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(start + (size_t)i * stride), offsets, sizeof(count_t));
+			__m256i equal = _mm256_cmpeq_epi32(_mm256_and_si256(v, mask), expected);
+			if (_mm256_movemask_epi8(equal) != -1)
+				return false;
+		}
+	}
+	for (; i < count; i++) {
+		if (start[(size_t)i * stride] != value)
+			return false;
+	}
+	return true;
+}
+
+template <typename count_t>
+inline bool isSameRun(const count_t* start, uint count, uint stride, uint value)
+{
+	//The gather instruction uses 32-bit offsets.
+	if (using_avx2 && count >= 8 && (uint64)stride * 8 < INT_MAX)
+		return isSameRun_avx2(start, count, stride, value);
+
+	for (uint i = 0; i < count; i++) {
+		if (start[(size_t)i * stride] != value)
+			return false;
+	}
+	return true;
+}
 
 inline ARGB gradient(int iterationCount, const vector<ARGB>& gradientColors, uint number_of_colors, float offset_term, float speed_factor)
 {
@@ -55,9 +127,126 @@ inline ARGB gradient(int iterationCount, const vector<ARGB>& gradientColors, uin
 	//The returned expression used to be a function but manual inlining turns out to be faster.
 }
 
+/*
+	The gradient colors of the iteration counts from 0 to maxIters, so that coloring a point is a lookup instead of the calculation in gradient(). FractalCanvas::gradientLUT makes a new one when the colors or maxIters change.
+	The gradient repeats itself every number_of_colors / speed_factor iterations, but that's usually not a whole number, so the table is indexed by the iteration count itself and not by the iteration count modulo the period.
+	Most renders use only a small part of the counts up to maxIters, so the table stops at the largest count that the last render found outside of minibrots (see FractalCanvas::largest_escaped_count), and at GRADIENT_LUT_MAXIMUM_SIZE. Larger counts are still colored correctly, with gradient().
+*/
+struct GradientLUT {
+	vector<ARGB> colors;
+	//the parameters that the table was made with
+	vector<ARGB> gradientColors;
+	float offset_term;
+	float speed_factor;
+
+	static uint size(const FractalParameters& P, uint largest_count) {
+		return (uint)min<uint64>((uint64)min(P.get_maxIters(), largest_count) + 1, GRADIENT_LUT_MAXIMUM_SIZE);
+	}
+
+	GradientLUT(const FractalParameters& P, uint largest_count)
+	: gradientColors(P.get_gradientColors())
+	, offset_term(P.get_gradientOffsetTerm())
+	, speed_factor(P.get_gradientSpeedFactor())
+	{
+		colors.resize(size(P, largest_count));
+		for (uint i=0; i<colors.size(); i++)
+			colors[i] = gradient(i, gradientColors, gradientColors.size(), offset_term, speed_factor);
+	}
+
+	bool matches(const FractalParameters& P, uint largest_count) const {
+		const vector<ARGB>& current = P.get_gradientColors();
+		return
+			offset_term == (float)P.get_gradientOffsetTerm()
+			&& speed_factor == (float)P.get_gradientSpeedFactor()
+			&& colors.size() == size(P, largest_count)
+			&& current.size() == gradientColors.size()
+			&& memcmp(current.data(), gradientColors.data(), current.size() * sizeof(ARGB)) == 0;
+	}
+
+	inline ARGB color(uint iterationCount) const {
+		if (iterationCount < colors.size())
+			return colors[iterationCount];
+		//Larger iteration counts are possible when maxIters was lowered after the render.
+		return gradient(iterationCount, gradientColors, gradientColors.size(), offset_term, speed_factor);
+	}
+};
+
+/*
+	Colors count points of the iteration data, starting at index, into out. Points in a minibrot are black.
+	flags is FractalCanvas::iterationFlags, which has to be readable 4 bytes past the end.
+*/
+template <typename count_t>
+[[gnu::target("avx2")]]
+inline void colorizePoints_avx2(const count_t* counts, const uint8* flags, uint index, uint count, const GradientLUT& lut, ARGB* out)
+{
+	const ARGB black = rgb(0, 0, 0);
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i last = _mm256_set1_epi32(lut.colors.size() - 1);
+	const __m256i black_v = _mm256_set1_epi32(bitcast<int>(black));
+	const __m256i minibrot_bit = _mm256_set1_epi32(FLAG_IN_MINIBROT);
+	uint i = 0;
+	for (; i + 8 <= count; i += 8) {
+		uint p = index + i;
+		__m256i c;
+		if constexpr(sizeof(count_t) == 2)
+			c = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + p)));
+		else
+			c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(counts + p));
+
+		//The flags of the 8 points are in (at most) 3 bytes. Every point has 2 bits.
+		uint32 f;
+		memcpy(&f, flags + (p >> 2), sizeof(f));
+		__m256i shifts = _mm256_slli_epi32(_mm256_add_epi32(lanes, _mm256_set1_epi32(p & 3)), 1);
+		__m256i bits = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(f), shifts), minibrot_bit);
+		__m256i inMinibrot = _mm256_cmpeq_epi32(bits, minibrot_bit);
+
+		//Counts beyond the table are done one by one. Points in a minibrot have the count maxIters, which can be beyond the table, but they're black anyway.
+		__m256i inTable = _mm256_cmpeq_epi32(_mm256_max_epu32(c, last), last);
+		if (_mm256_movemask_epi8(_mm256_or_si256(inTable, inMinibrot)) != -1) {
+			for (uint j=i; j<i+8; j++) {
+				uint q = index + j;
+				bool inMinibrot = (flags[q >> 2] >> ((q & 3) << 1)) & FLAG_IN_MINIBROT;
+				out[j] = inMinibrot ? black : lut.color(counts[q]);
+			}
+			continue;
+		}
+		__m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut.colors.data()), _mm256_min_epu32(c, last), 4);
+		colors = _mm256_blendv_epi8(colors, black_v, inMinibrot);
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), colors);
+	}
+	for (; i < count; i++) {
+		uint q = index + i;
+		bool inMinibrot = (flags[q >> 2] >> ((q & 3) << 1)) & FLAG_IN_MINIBROT;
+		out[i] = inMinibrot ? black : lut.color(counts[q]);
+	}
+}
+
+template <typename count_t>
+inline void colorizePoints(const count_t* counts, const uint8* flags, uint index, uint count, const GradientLUT& lut, ARGB* out)
+{
+	if (using_avx2) {
+		colorizePoints_avx2(counts, flags, index, count, lut, out);
+		return;
+	}
+	const ARGB black = rgb(0, 0, 0);
+	for (uint i=0; i<count; i++) {
+		uint q = index + i;
+		bool inMinibrot = (flags[q >> 2] >> ((q & 3) << 1)) & FLAG_IN_MINIBROT;
+		out[i] = inMinibrot ? black : lut.color(counts[q]);
+	}
+}
+
 class FractalCanvas {
 public:
-	IterData* iters{ nullptr }; //iteration data array, managed by FractalCanvas
+	/*
+		The iteration data is stored in two arrays, both managed by FractalCanvas and in the layout described at itersIndex_of_itersXY:
+		iterationCounts: the iteration count of every point. The counts are 16-bit (uint16) if maxIters fits in 16 bits, otherwise 32-bit (uint32), see needs_wide_counts. Most renders use less than 65536 iterations, so this usually halves the memory that's needed.
+		iterationFlags: the flags guessed and inMinibrot of every point, packed in 2 bits per point (see FLAG_GUESSED and FLAG_IN_MINIBROT), so the flags of 4 points share a byte.
+	*/
+	void* iterationCounts{ nullptr };
+	uint8* iterationFlags{ nullptr };
+	bool wide_counts{ false };
 	ARGB* ptPixels{ nullptr }; //bitmap colors representing the iteration data, managed by the bitmapManager, not FractalCanvas
 private:
 	FractalParameters mP;
@@ -79,6 +268,25 @@ public:
 	int otherActiveThreads{ 0 };
 
 	uint number_of_threads;
+	RenderStatistics lastRenderStatistics; //of the last render that finished
+private:
+	//When the last renders were cancelled, at the index renderID % CANCEL_TIMES. See newRenderID.
+	struct CancelTime {
+		int renderID = -1;
+		chrono::high_resolution_clock::time_point time;
+	};
+	static constexpr int CANCEL_TIMES = 16;
+	CancelTime cancelTimes[CANCEL_TIMES];
+	mutex cancelTimesMutex;
+
+	//The part of the bitmap that's shown on the screen, in pixels of the bitmap. See setVisibleRegion.
+	uint visible_x{ 0 };
+	uint visible_y{ 0 };
+	uint visible_width{ UINT_MAX };
+	uint visible_height{ UINT_MAX };
+public:
+	RenderAlgorithm render_algorithm{ RenderAlgorithm::MarianiSilver }; //used by new renders
+	const bool blocked_layout; //the layout of the iteration data, see itersIndex_of_itersXY
 	shared_ptr<BitmapManager> bitmapManager;
 	vector<GUIInterface*> GUIs; //there will usually be 1 GUI, but I want to make it possible to have 0 GUIs for commandline rendering.
 
@@ -112,8 +320,9 @@ public:
 		if(debug) cout << "FractalCanvas ended all usage" << endl;
 	}
 
-	FractalCanvas(uint number_of_threads, shared_ptr<BitmapManager> bitmapManager, vector<GUIInterface*> GUIs = {})
-	: bitmapManager(bitmapManager)
+	FractalCanvas(uint number_of_threads, shared_ptr<BitmapManager> bitmapManager, vector<GUIInterface*> GUIs = {}, bool blocked_layout = using_blocked_layout)
+	: blocked_layout(blocked_layout)
+	, bitmapManager(bitmapManager)
 	, GUIs(GUIs)
 	{
 		assert(number_of_threads > 0);
@@ -140,12 +349,13 @@ public:
 	FractalCanvas& operator=(const FractalCanvas& other) = delete;
 
 	//todo: consider changing this. The destructor waits for all threads using the FractalCanvas to end. This includes threads created by the FractalCanvas member functions, which I think is good. The FractalCanvas creates them, and so it's responsible for them. But it also includes threads created by the GUI. The GUI should be responsible for ending those threads before destroying a FractalCanvas.
-	//Maybe it's also better to use unique_ptr instead of a normal pointer for iters (not important because it already works).
+	//Maybe it's also better to use unique_ptr instead of normal pointers for the iteration data (not important because it already works).
 	~FractalCanvas() {
 		if(debug) cout << "deleting FractalCanvas " << this << endl;
 
 		end_all_usage();
-		free(iters);
+		bufferPool.release(counts_buffer);
+		bufferPool.release(flags_buffer);
 
 		if(debug) cout << "deleted FractalCanvas " << this << endl;
 	}
@@ -213,7 +423,24 @@ public:
 			This causes active renders to stop. It doesn't actively cancel anything, rather it's the render itself that checks, every so often, whether it should stop.
 			Changing the lastRenderID here doesn't require a lock. If it happens that another threads is also changing lastRenderID, that must be because of another cancellation or new render, which already has the desired effect.
 		*/
-		++lastRenderID;
+		newRenderID();
+	}
+
+	//A new render ID also stops the render that's active. The time is kept to know how long it takes before the render stops.
+	int newRenderID() {
+		lock_guard<mutex> guard(cancelTimesMutex);
+		cancelTimes[lastRenderID % CANCEL_TIMES] = { lastRenderID, chrono::high_resolution_clock::now() };
+		return ++lastRenderID;
+	}
+
+	//When the render with ID renderID was cancelled. Returns false if that's not known (anymore).
+	bool cancelTime(int renderID, chrono::high_resolution_clock::time_point& time) {
+		lock_guard<mutex> guard(cancelTimesMutex);
+		const CancelTime& cancel = cancelTimes[renderID % CANCEL_TIMES];
+		if (cancel.renderID != renderID)
+			return false;
+		time = cancel.time;
+		return true;
 	}
 
 	void cancelBitmapRender() {
@@ -241,8 +468,7 @@ public:
 
 		auto fractalcanvas_realloc = [&](uint64 size) {
 			cout << "reallocating fractalcanvas to size: " << size << endl;
-			free(iters);
-			iters = (IterData*)malloc(size * sizeof(IterData));
+			allocateIters(size, needs_wide_counts(mP));
 			cout << "reallocated fractalcanvas" << endl;
 		};
 
@@ -266,16 +492,24 @@ public:
 		uint64 new_width_bitmap = new_.width_bitmap();
 		uint64 new_height_bitmap = new_.height_bitmap();
 
-		uint64 bitmap_size = new_width_bitmap * new_height_bitmap;
-		uint64 old_bitmap_size = old_width_bitmap * old_height_bitmap;
-		uint64 fractalcanvas_size = new_width_canvas * new_height_canvas; //this really needs the 64-bit accuracy
-		uint64 old_fractalcanvas_size = old_width_canvas * old_height_canvas;
+		uint64 old_width_resolution = old.width_resolution();
+		uint64 old_height_resolution = old.height_resolution();
+		uint64 new_width_resolution = new_.width_resolution();
+		uint64 new_height_resolution = new_.height_resolution();
 
-		bool realloc_bitmap = old_bitmap_size != bitmap_size;
+		//The bitmap has the size of the resolution. bitmap_zoom is applied when drawing it.
+		uint64 bitmap_size = new_width_resolution * new_height_resolution;
+		uint64 fractalcanvas_size = iters_size(new_width_canvas, new_height_canvas); //this really needs the 64-bit accuracy
+		uint64 old_fractalcanvas_size = iters_size(old_width_canvas, old_height_canvas);
+
+		bool realloc_bitmap = old_width_resolution != new_width_resolution || old_height_resolution != new_height_resolution;
 		bool realloc_fractalcanvas = old_fractalcanvas_size != fractalcanvas_size;
+		//A different bitmap_zoom with the same resolution changes only the size on the screen.
+		bool screen_size_changed = old_width_bitmap != new_width_bitmap || old_height_bitmap != new_height_bitmap;
 
-		if (!realloc_bitmap && !realloc_fractalcanvas) {
+		if (!realloc_bitmap && !realloc_fractalcanvas && !screen_size_changed) {
 			cout << "entered resize. The resolutions remain the same. Nothing happens." << endl;
+			updateItersLayout();
 			return {true, false, ResizeResultType::Success};
 		}
 		else {
@@ -309,10 +543,10 @@ public:
 				fractalcanvas_realloc(fractalcanvas_size);
 			}
 			if (realloc_bitmap) {
-				bitmap_realloc(new_width_bitmap, new_height_bitmap);
+				bitmap_realloc(new_width_resolution, new_height_resolution);
 			}
 
-			if (iters == nullptr || ptPixels == nullptr) {
+			if (iterationCounts == nullptr || ptPixels == nullptr) {
 				//Allocating memory failed.
 				res = ResizeResultType::MemoryError;
 				success = false;
@@ -321,26 +555,28 @@ public:
 				mP.resize(old_target_width, old_target_height, oldOversampling, oldBitmapZoom);
 
 				if (realloc_fractalcanvas) {
-					fractalcanvas_realloc(old_width_canvas * old_height_canvas);
+					fractalcanvas_realloc(old_fractalcanvas_size);
 				}
 				if (realloc_bitmap) {
-					bitmap_realloc(old_width_bitmap, old_height_bitmap);
+					bitmap_realloc(old_width_resolution, old_height_resolution);
 				}
 
-				if (iters != nullptr && ptPixels != nullptr) {
+				if (iterationCounts != nullptr && ptPixels != nullptr) {
 					changed = false;
 					cout << "Allocating memory failed. The previous resolution has been restored." << endl;
 				}
 				else {
 					//As a last resort, change the image size to 1x1. This can't fail in any reasonable situation.
 					mP.resize(1,1,1,1);
-					fractalcanvas_realloc(1);
+					fractalcanvas_realloc(iters_size(1,1));
 					bitmap_realloc(1,1);
 					changed = true;
 					cout << "Allocating memory failed. The resolution has changed to 1x1." << endl;
 				}
 			}
+			updateItersLayout();
 		}
+		bufferPool.trim(); //the old buffers of this size change, if they weren't used again
 		return {success, changed, res};
 	}
 
@@ -359,7 +595,6 @@ public:
 		parametersChangedEvent(source_id);
 	};
 
-	private: FractalParameters temp;
 public:
 
 	/*
@@ -385,22 +620,27 @@ public:
 		// If check_modified_memory, the action is first applied to a copy of the parameters, to see if the changes require allocating new memory. In that case, the parameters should not be changed during a render. The generality of accepting a function makes programming the GUI a lot easier, but it requires this kind of check.
 		//
 		// check_modified_memory can be set to false to skip the check for efficiency. Then the action is simply applied to the parameters, even if there's a render going on. It's the responsibility of the user of changeParameters to disable the check only when it is known in advance that no memory allocation can occur during a render.
+		// Copying the parameters is cheap because the large vectors in them are shared until they're changed (see SharedVector).
 		//
 
+		bool modifiedMemory = false;
+		bool modifiedSize = false;
 		if (check_modified_memory) {
 			// After this temp.modifiedMemory will indicate whether the action would require allocating memory
-			temp.fromParameters(mP);
+			FractalParameters temp = mP;
 			temp.clearModified();
 			action(temp);
+			modifiedMemory = temp.modifiedMemory;
+			modifiedSize = temp.modifiedSize;
 		}
 
-		if ( ! check_modified_memory || ! temp.modifiedMemory) {
+		if ( ! check_modified_memory || ! modifiedMemory) {
 			if(debug) cout << "changeParameters at location 1" << endl;
 			action(mP);
 			postResizeActions(res, source_id);
 		}
 		else {
-			if (temp.modifiedSize) {
+			if (modifiedSize) {
 				if(debug) cout << "changeParameters at location 2" << endl;
 				{
 					cancelRender();
@@ -486,14 +726,12 @@ public:
 	//todo: move these index calculating functions out of class FractalCanvas. They're more generally applicable.
 
 	//	returns the index in ptPixels of (x, y) in the bitmap
-	// When bitmap_zoom > 1 this returns the index of the topleft corner pixel of the block of pixels belonging to this coordinate.
-	// You can think of it like this: there is a conceptual bitmap that could be in memory, but is not for performance, that has the actual size of the fractalCanvas (screenWidth * screenHeight). This function accepts coordinates in that bitmap, and gives an/the index of those coordinates in the real bitmap, which is larger if bitmap_zoom > 1.
+	// The bitmap has one pixel for every pixel of the resolution, also when bitmap_zoom > 1. The GUI enlarges it when drawing it on the screen.
 	inline uint pixelIndex_of_pixelXY(uint x, uint y)
 	{
 		assert(x >= 0); assert(x < mP.width_resolution());
 		assert(y >= 0); assert(y < mP.height_resolution());
-		const uint& bitmap_zoom = mP.get_bitmap_zoom();
-		return (mP.width_resolution() * bitmap_zoom * y * bitmap_zoom) + (x * bitmap_zoom);
+		return mP.width_resolution() * y + x;
 	}
 
 	//unused?
@@ -506,10 +744,193 @@ public:
 		return pixelIndex_of_pixelXY(x / oversampling, y / oversampling);
 	}
 
+	/*
+		There are two layouts for the iteration data:
+
+		pixel-major: pixels are stored row by row, and the oversampling*oversampling points of a pixel are stored together. That's convenient to calculate the colors but walking along a vertical line jumps a whole row of pixels every oversampling points.
+
+		blocked: the canvas is divided into blocks of 16x16 points (see ITERS_BLOCK_SHIFT). Blocks are stored row by row and the points within a block are also stored row by row. A block is 1 KB, so a horizontal or vertical line of 16 points stays within a few cache lines, which helps the boundary scans in the Render class. The index can be computed with shifts and masks. The width and height are padded to a multiple of 16 for this. This is the default.
+	*/
+	inline uint64 iters_size(uint64 width_canvas, uint64 height_canvas) {
+		if (blocked_layout) {
+			constexpr uint64 mask = (1 << ITERS_BLOCK_SHIFT) - 1;
+			return ((width_canvas + mask) & ~mask) * ((height_canvas + mask) & ~mask);
+		}
+		return width_canvas * height_canvas;
+	}
+
+private:
+	uint iters_block_row_size; //the number of points in one row of blocks in the blocked layout
+	uint64 iters_allocated_size{ 0 }; //the number of points in the iteration data arrays
+	PooledBuffer counts_buffer; //the memory of iterationCounts, from the bufferPool
+	PooledBuffer flags_buffer; //the memory of iterationFlags
+
+	/*
+		Makes the iteration data arrays fit size points with counts of the given width. The buffers are only replaced if they're too small. If allocating fails, both arrays are nullptr.
+	*/
+	void allocateIters(uint64 size, bool wide) {
+		//The counts are padded with 32 bytes because isSameRun_avx2 reads 32-bit values when gathering 16-bit counts.
+		size_t counts_size = size * (wide ? sizeof(uint32) : sizeof(uint16)) + 32;
+		size_t flags_size = (size + 3) / 4 + 4; //padded for colorizePoints_avx2
+		if ( ! bufferPool.ensureCapacity(counts_buffer, counts_size)
+			|| ! bufferPool.ensureCapacity(flags_buffer, flags_size)
+		) {
+			bufferPool.release(counts_buffer);
+			bufferPool.release(flags_buffer);
+			iterationCounts = nullptr;
+			iterationFlags = nullptr;
+			iters_allocated_size = 0;
+			return;
+		}
+		iterationCounts = counts_buffer.data;
+		iterationFlags = (uint8*)flags_buffer.data;
+		memset(iterationFlags, 0, flags_size);
+		wide_counts = wide;
+		iters_allocated_size = size;
+	}
+
+	template <typename count_t>
+	inline count_t* counts() {
+		return static_cast<count_t*>(iterationCounts);
+	}
+
+	inline uint iterationCountAt(uint index) {
+		return wide_counts ? counts<uint32>()[index] : counts<uint16>()[index];
+	}
+
+	inline IterData iterDataAt(uint index) {
+		//Other threads may be setting the flags of the other points in the same byte, see setPixel.
+		uint8 flags = __atomic_load_n(&iterationFlags[index >> 2], __ATOMIC_RELAXED) >> ((index & 3) << 1);
+		return { iterationCountAt(index), (flags & FLAG_GUESSED) != 0, (flags & FLAG_IN_MINIBROT) != 0 };
+	}
+
+	inline bool isSameRunAt(uint index, uint count, uint stride, uint value) {
+		if (wide_counts)
+			return isSameRun(counts<uint32>() + index, count, stride, value);
+		return isSameRun(counts<uint16>() + index, count, stride, value);
+	}
+
+	inline void colorizePointsAt(uint index, uint count, const GradientLUT& lut, ARGB* out) {
+		if (wide_counts)
+			colorizePoints(counts<uint32>(), iterationFlags, index, count, lut, out);
+		else
+			colorizePoints(counts<uint16>(), iterationFlags, index, count, lut, out);
+	}
+
+	//Colors the points from (xfrom, y) to (xto, y). Only for the layouts where these points are stored together, which is the blocked layout, or the pixel-major layout without oversampling.
+	void colorizePointRow(uint xfrom, uint xto, uint y, const GradientLUT& lut, ARGB* out) {
+		if ( ! blocked_layout) {
+			assert(mP.get_oversampling() == 1);
+			colorizePointsAt(itersIndex_of_itersXY(xfrom, y), xto - xfrom, lut, out);
+			return;
+		}
+		constexpr uint block_size = 1 << ITERS_BLOCK_SHIFT;
+		for (uint x = xfrom; x < xto; ) {
+			uint to = min(xto, (x & ~(block_size - 1)) + block_size); //the end of the row or the end of the block
+			colorizePointsAt(itersIndex_of_itersXY(x, y), to - x, lut, out + (x - xfrom));
+			x = to;
+		}
+	}
+
+	AtomicSharedPtr<const GradientLUT> gradient_lut;
+	mutex gradientLUTMutex;
+	atomic<uint> largest_escaped_count{ UINT_MAX }; //the largest iteration count of the points outside of minibrots, or UINT_MAX if that's not known. Set after every render that finishes.
+
+public:
+	/*
+		Returns the GradientLUT for the current parameters. Bitmap renders run in several threads at the same time, so the table is replaced (not changed) when the parameters change, and threads that still use the old one keep it alive.
+	*/
+	shared_ptr<const GradientLUT> gradientLUT() {
+		uint largest_count = largest_escaped_count;
+		shared_ptr<const GradientLUT> lut = gradient_lut.load();
+		if (lut != nullptr && lut->matches(mP, largest_count))
+			return lut;
+		lock_guard<mutex> guard(gradientLUTMutex);
+		lut = gradient_lut.load();
+		if (lut == nullptr || ! lut->matches(mP, largest_count)) {
+			lut = make_shared<const GradientLUT>(mP, largest_count);
+			gradient_lut.store(lut);
+		}
+		return lut;
+	}
+private:
+
+	//The padding of the blocked layout is skipped, because the buffers can have old data there.
+	template <typename count_t>
+	uint largestEscapedCount(const count_t* counts) {
+		uint largest = 0;
+		for (uint y=0; y<mP.height_canvas(); y++)
+		for (uint x=0; x<mP.width_canvas(); x++) {
+			uint i = itersIndex_of_itersXY(x, y);
+			bool inMinibrot = (iterationFlags[i >> 2] >> ((i & 3) << 1)) & FLAG_IN_MINIBROT;
+			if ( ! inMinibrot && counts[i] > largest)
+				largest = counts[i];
+		}
+		return largest;
+	}
+
+	//Called after a render is done. Colors of later bitmap renders, for example after changing the gradient, then only need a table up to this count.
+	void updateLargestEscapedCount() {
+		largest_escaped_count = wide_counts ? largestEscapedCount(counts<uint32>()) : largestEscapedCount(counts<uint16>());
+	}
+
+	void updateItersLayout() {
+		uint blocks_per_row = (mP.width_canvas() + (1 << ITERS_BLOCK_SHIFT) - 1) >> ITERS_BLOCK_SHIFT;
+		iters_block_row_size = blocks_per_row << (2 * ITERS_BLOCK_SHIFT);
+	}
+public:
+
+	//The iteration data as it is in memory, for saving it (see IterationDataFile.cpp)
+	struct RawIterationData {
+		const void* counts;
+		size_t counts_size; //in bytes, including the padding
+		const uint8* flags;
+		size_t flags_size;
+		uint64 points;
+		bool wide;
+	};
+
+	RawIterationData rawIterationData() {
+		uint64 size = iters_allocated_size;
+		return {
+			iterationCounts, size * (wide_counts ? sizeof(uint32) : sizeof(uint16)) + 32
+			,iterationFlags, (size + 3) / 4 + 4
+			,size, wide_counts
+		};
+	}
+
+	/*
+		Makes the canvas use the buffers counts and flags as its iteration data, for example a mapped iteration data file. The buffers need to have the size (and padding) that allocateIters uses for the current parameters. Active renders are cancelled.
+	*/
+	void adoptIterationData(PooledBuffer counts, PooledBuffer flags, bool wide)
+	{
+		cancelRender();
+		lock_guard<mutex> guard(activeRender);
+		cancelBitmapRender();
+		lock_guard<mutex> guard2(activeBitmapRender);
+
+		bufferPool.release(counts_buffer);
+		bufferPool.release(flags_buffer);
+		counts_buffer = counts;
+		flags_buffer = flags;
+		iterationCounts = counts_buffer.data;
+		iterationFlags = (uint8*)flags_buffer.data;
+		wide_counts = wide;
+		iters_allocated_size = iters_size(mP.width_canvas(), mP.height_canvas());
+		largest_escaped_count = UINT_MAX;
+	}
+
 	inline uint itersIndex_of_itersXY(uint x, uint y) {
 		assert(x >= 0); assert(x < mP.width_canvas());
 		assert(y >= 0); assert(y < mP.height_canvas());
-		//returns the index in iters of (x, y) in the fractalcanvas
+		//returns the index in the iteration data of (x, y) in the fractalcanvas
+		if (blocked_layout) {
+			constexpr uint mask = (1 << ITERS_BLOCK_SHIFT) - 1;
+			return (y >> ITERS_BLOCK_SHIFT) * iters_block_row_size
+				+ ((x >> ITERS_BLOCK_SHIFT) << (2 * ITERS_BLOCK_SHIFT))
+				+ ((y & mask) << ITERS_BLOCK_SHIFT)
+				+ (x & mask);
+		}
 		uint width_resolution = mP.width_resolution();
 		uint oversampling = mP.get_oversampling();
 		uint samples = oversampling * oversampling;
@@ -522,11 +943,70 @@ public:
 	
 
 	inline uint getIterationcount(uint x, uint y) {
-		return iters[itersIndex_of_itersXY(x,y)].iterationCount;
+		return iterationCountAt(itersIndex_of_itersXY(x,y));
 	}
 
 	inline IterData getIterData(uint x, uint y) {
-		return iters[itersIndex_of_itersXY(x,y)];
+		return iterDataAt(itersIndex_of_itersXY(x,y));
+	}
+
+	/*
+		Whether all points from (xFrom, y) to (xTo, y) have the same iterationcount. Including from; not including to.
+		The line is split into parts that have a constant distance between the points in memory, which can be compared with SIMD instructions.
+	*/
+	bool isSameHorizontalLine(uint xFrom, uint xTo, uint y)
+	{
+		assert(xTo >= xFrom);
+		uint value = getIterationcount(xFrom, y);
+
+		if (blocked_layout) {
+			constexpr uint block_size = 1 << ITERS_BLOCK_SHIFT;
+			for (uint x = xFrom; x < xTo; ) {
+				uint to = min(xTo, (x & ~(block_size - 1)) + block_size); //the end of the line or the end of the block
+				if ( ! isSameRunAt(itersIndex_of_itersXY(x, y), to - x, 1, value))
+					return false;
+				x = to;
+			}
+			return true;
+		}
+		//With the pixel-major layout, the points in a horizontal line are always oversampling values apart.
+		if (xTo == xFrom)
+			return true;
+		return isSameRunAt(itersIndex_of_itersXY(xFrom, y), xTo - xFrom, mP.get_oversampling(), value);
+	}
+
+	/*
+		Whether all points from (x, yFrom) to (x, yTo) have the same iterationcount. Including from; not including to.
+	*/
+	bool isSameVerticalLine(uint yFrom, uint yTo, uint x)
+	{
+		assert(yTo >= yFrom);
+		uint value = getIterationcount(x, yFrom);
+
+		if (blocked_layout) {
+			constexpr uint block_size = 1 << ITERS_BLOCK_SHIFT;
+			for (uint y = yFrom; y < yTo; ) {
+				uint to = min(yTo, (y & ~(block_size - 1)) + block_size);
+				if ( ! isSameRunAt(itersIndex_of_itersXY(x, y), to - y, block_size, value))
+					return false;
+				y = to;
+			}
+			return true;
+		}
+		const uint oversampling = mP.get_oversampling();
+		if (oversampling == 1) {
+			if (yTo == yFrom)
+				return true;
+			return isSameRunAt(itersIndex_of_itersXY(x, yFrom), yTo - yFrom, mP.width_resolution(), value);
+		}
+		//The points of one pixel in a vertical line are stored together.
+		for (uint y = yFrom; y < yTo; ) {
+			uint to = min(yTo, (y / oversampling + 1) * oversampling);
+			if ( ! isSameRunAt(itersIndex_of_itersXY(x, y), to - y, 1, value))
+				return false;
+			y = to;
+		}
+		return true;
 	}
 
 	inline double_c map(uint xPos, uint yPos) {
@@ -538,230 +1018,221 @@ public:
 		assert(i >= 0 && j >= 0);
 		assert(i < mP.width_canvas() && j < mP.height_canvas());
 
-		IterData result{ iterationCount, guessed, isInMinibrot };
 		uint index = itersIndex_of_itersXY(i, j);
-		iters[index] = result;
+		if (wide_counts) {
+			counts<uint32>()[index] = iterationCount;
+		}
+		else {
+			assert(iterationCount <= UINT16_MAX);
+			counts<uint16>()[index] = iterationCount;
+		}
+		//The flags of 4 points share a byte, which other threads can be changing at the same time, so it's changed with atomic operations. Usually the flags don't change, and then reading is enough.
+		uint shift = (index & 3) << 1;
+		uint8 flags = (guessed ? FLAG_GUESSED : 0) | (isInMinibrot ? FLAG_IN_MINIBROT : 0);
+		uint8* flags_byte = &iterationFlags[index >> 2];
+		if (((__atomic_load_n(flags_byte, __ATOMIC_RELAXED) >> shift) & 3) != flags) {
+			__atomic_fetch_and(flags_byte, (uint8)~(3 << shift), __ATOMIC_RELAXED);
+			__atomic_fetch_or(flags_byte, (uint8)(flags << shift), __ATOMIC_RELAXED);
+		}
 	}
 	
 	void renderBitmapRect(bool highlight_guessed, uint xfrom, uint xto, uint yfrom, uint yto) {
 		const uint width_resolution = mP.width_resolution();
 		const uint height_resolution = mP.height_resolution();
 		const uint oversampling = mP.get_oversampling();
-		const uint bitmap_zoom = mP.get_bitmap_zoom();
 		const uint samples = oversampling * oversampling;
 
-		const vector<ARGB>& gradientColors = mP.get_gradientColors();
-		const float offset_term = mP.get_gradientOffsetTerm();
-		const float speed_factor =  mP.get_gradientSpeedFactor();
-		const uint number_of_colors = gradientColors.size();
-
 		assert(xfrom >= 0); assert(xfrom <= width_resolution);
 		assert(xto >= xfrom); assert(xto <= width_resolution);
 		assert(yfrom >= 0); assert(yfrom <= height_resolution);
 		assert(yto >= yfrom); assert(yto <= height_resolution);
 
-		//One implementation that always works (with oversampling and bitmap zoom) is significantly slower. That's why I have a dedicated implementation for every case:
-		if (highlight_guessed == false)
-		{
-			if (bitmap_zoom == 1 && samples == 1) {
-				for (uint py=yfrom; py<yto; py++)
-				{
-					ptrdiff_t pixelIndex_col = py * width_resolution;
+		if (xto == xfrom)
+			return;
 
-					for (int px=xfrom; px<xto; px++)
-					{
-						ARGB color;
-						IterData it = iters[pixelIndex_col + px];
-						if (it.inMinibrot)
-							color = rgb(0, 0, 0);
-						else
-							color = gradient(it.iterationCount, gradientColors, number_of_colors, offset_term, speed_factor);
-
-						ptPixels[pixelIndex_col + px] = color;
-					}
-				}
-			}
-			else if (bitmap_zoom == 1 && samples > 1)
+		shared_ptr<const GradientLUT> lut = gradientLUT();
+
+		if (highlight_guessed)
+		{
+			//This is only used to see what the render algorithm does, so it doesn't need to be fast. It works for all cases.
+			for (uint py=yfrom; py<yto; py++)
 			{
-				for (uint py=yfrom; py<yto; py++)
+				for (uint px=xfrom; px<xto; px++)
 				{
-					ptrdiff_t pixelIndex_col = py * width_resolution;
+					uint sumR=0, sumG=0, sumB=0;
+					ARGB color;
 
-					for (uint px=xfrom; px<xto; px++)
-					{
-						ptrdiff_t pixelIndex = pixelIndex_col + px;
-						ptrdiff_t itersStartIndex = pixelIndex * samples;
-						
-						int sumR=0, sumG=0, sumB=0;
-						ARGB color;
-
-						for (int i=0; i<samples; i++) {
-							IterData it = iters[itersStartIndex + i];
-							if (it.inMinibrot)
-								color = rgb(0, 0, 0);
-							else
-								color = color = gradient(it.iterationCount, gradientColors, number_of_colors, offset_term, speed_factor);
+					for (uint y = py * oversampling; y < (py + 1) * oversampling; y++) {
+						for (uint x = px * oversampling; x < (px + 1) * oversampling; x++) {
+							IterData it = iterDataAt(itersIndex_of_itersXY(x, y));
+							if (it.inMinibrot && !it.guessed) color = rgb(255, 0, 0);
+							else if (it.inMinibrot)           color = rgb(0, 0, 255);
+							else if (it.guessed)              color = rgb(0, 255, 0);
+							else                              color = lut->color(it.iterationCount);
 							sumR += color.R;
 							sumG += color.G;
 							sumB += color.B;
 						}
-
-						color = rgb(
-							(uint8)(sumR / samples),
-							(uint8)(sumG / samples),
-							(uint8)(sumB / samples)
-						);
-
-						ptPixels[pixelIndex] = color;
 					}
+					ptPixels[pixelIndex_of_pixelXY(px, py)] = rgb(
+						(uint8)(sumR / samples),
+						(uint8)(sumG / samples),
+						(uint8)(sumB / samples)
+					);
 				}
 			}
-			else if (bitmap_zoom > 1 && samples == 1) {
-				const uint row_width = width_resolution * bitmap_zoom;
+			return;
+		}
 
-				for (uint py=yfrom; py<yto; py++)
-				{
-					ptrdiff_t itersStartIndex = py * width_resolution;
-					ptrdiff_t pixelIndex_col = width_resolution * bitmap_zoom * py;
+		/*
+			Every row of pixels is done in two steps: first all points are colored with the lookup table, which is vectorized, and then the colors of the points of every pixel are averaged. Without oversampling, the colors go directly to the bitmap.
+		*/
+		const uint pixels = xto - xfrom;
+		vector<ARGB> point_colors(samples > 1 ? pixels * samples : 0);
 
-					for (uint px=xfrom; px<xto; px++)
-					{
-						ARGB color;
-						IterData it = iters[itersStartIndex + px];
-						if (it.inMinibrot)
-							color = rgb(0, 0, 0);
-						else
-							color = gradient(it.iterationCount, gradientColors, number_of_colors, offset_term, speed_factor);
-
-						ptrdiff_t pixelIndex = (pixelIndex_col + px) * bitmap_zoom;
-						for (int i=0; i<bitmap_zoom; i++) {
-							for (int j=0; j<bitmap_zoom; j++) {
-								ptPixels[pixelIndex + i + row_width * j] = color;
-							}
-						}
+		for (uint py=yfrom; py<yto; py++)
+		{
+			ARGB* row = &ptPixels[pixelIndex_of_pixelXY(xfrom, py)];
+
+			if (samples == 1) {
+				colorizePointRow(xfrom, xto, py, *lut, row);
+			}
+			else if ( ! blocked_layout) {
+				//The points of a pixel are stored together, and so are the pixels of a row.
+				colorizePointsAt(itersIndex_of_itersXY(xfrom * oversampling, py * oversampling), pixels * samples, *lut, point_colors.data());
+				const ARGB* c = point_colors.data();
+				for (uint i=0; i<pixels; i++) {
+					uint sumR=0, sumG=0, sumB=0;
+					for (uint j=0; j<samples; j++, c++) {
+						sumR += c->R;
+						sumG += c->G;
+						sumB += c->B;
 					}
+					row[i] = rgb(
+						(uint8)(sumR / samples),
+						(uint8)(sumG / samples),
+						(uint8)(sumB / samples)
+					);
 				}
 			}
 			else {
-				assert(bitmap_zoom > 1 && samples > 1);
-				//This case is unlikely because it cannot be reached through the user interface, but by loading JSON parameters it can be reached. With the GUI, only oversampling OR bitmap_zoom can be set, not both.
-				const uint row_width = width_resolution * bitmap_zoom;
-
-				for (uint py=yfrom; py<yto; py++)
-				{
-					for (uint px=xfrom; px<xto; px++)
-					{
-						uint itersStartIndex = (px + py * width_resolution) * samples;
-
-						uint sumR=0, sumG=0, sumB=0;
-						ARGB color;
-		
-						for (uint i=0; i<samples; i++) {
-							IterData it = iters[itersStartIndex + i];
-							if (it.inMinibrot)			      color = rgb(0, 0, 0);
-							else                              color = gradient(it.iterationCount, gradientColors, number_of_colors, offset_term, speed_factor);
-							sumR += color.R;
-							sumG += color.G;
-							sumB += color.B;
-						}
-
-						uint pixelIndex = pixelIndex_of_pixelXY(px, py);
-						ARGB new_color = rgb(
-							(uint8)(sumR / samples),
-							(uint8)(sumG / samples),
-							(uint8)(sumB / samples)
-						);
-
-						for (int i=0; i<bitmap_zoom; i++) {
-							for (int j=0; j<bitmap_zoom; j++) {
-								ptPixels[pixelIndex + i + row_width * j] = new_color;
-							}
-						}
-					}
+				//point_colors contains oversampling rows of points
+				const uint points_per_row = pixels * oversampling;
+				for (uint dy=0; dy<oversampling; dy++) {
+					colorizePointRow(xfrom * oversampling, xto * oversampling, py * oversampling + dy, *lut, &point_colors[dy * points_per_row]);
 				}
-			}
-		}
-		else {
-			//highlight_guessed is true
-			const uint row_width = width_resolution * bitmap_zoom;
-
-			for (uint py=yfrom; py<yto; py++)
-			{
-				for (uint px=xfrom; px<xto; px++)
-				{
-					uint itersStartIndex = (px + py * width_resolution) * samples;
-
+				for (uint i=0; i<pixels; i++) {
 					uint sumR=0, sumG=0, sumB=0;
-					ARGB color;
-		
-					for (uint i=0; i<samples; i++) {
-						IterData it = iters[itersStartIndex + i];
-						if (it.inMinibrot && !it.guessed) color = rgb(255, 0, 0);
-						else if (it.inMinibrot)           color = rgb(0, 0, 255);
-						else if (it.guessed)              color = rgb(0, 255, 0);
-						else
-							color = gradient(it.iterationCount, gradientColors, number_of_colors, offset_term, speed_factor);
-						sumR += color.R;
-						sumG += color.G;
-						sumB += color.B;
+					for (uint dy=0; dy<oversampling; dy++) {
+						const ARGB* c = &point_colors[dy * points_per_row + i * oversampling];
+						for (uint dx=0; dx<oversampling; dx++) {
+							sumR += c[dx].R;
+							sumG += c[dx].G;
+							sumB += c[dx].B;
+						}
 					}
-
-					uint pixelIndex = pixelIndex_of_pixelXY(px, py);
-					ARGB new_color = rgb(
+					row[i] = rgb(
 						(uint8)(sumR / samples),
 						(uint8)(sumG / samples),
 						(uint8)(sumB / samples)
 					);
-
-					for (int i=0; i<bitmap_zoom; i++) {
-						for (int j=0; j<bitmap_zoom; j++) {
-							ptPixels[pixelIndex + i + row_width * j] = new_color;
-						}
-					}
 				}
 			}
 		}
 	}
 
-	void renderBitmapFull(bool highlight_guessed, bool multithreading) {
-		uint screenWidth = mP.width_resolution();
-		uint screenHeight = mP.height_resolution();
+	//The GUI uses this to tell which part of the bitmap is on the screen, so that bitmap renders can do that part first.
+	void setVisibleRegion(uint x, uint y, uint width, uint height) {
+		lock_guard<mutex> guard(genericMutex);
+		visible_x = x;
+		visible_y = y;
+		visible_width = width;
+		visible_height = height;
+	}
+
+	/*
+		Colors the whole bitmap in tiles of BITMAP_TILE_SIZE pixels. The tiles that are on the screen are done first, from the center outward, and then the rest.
 
-		//use multithreading for extra speed when there's no render active
-		if (multithreading) {
-			if(debug) cout << "using multiple threads for renderBitmapFull" << endl;
-			uint tiles = (uint)(sqrt(number_of_threads)); //the number of tiles in both horizontal and vertical direction, so in total there are (tiles * tiles)
-			tiles = min({tiles, screenWidth, screenHeight});
-
-			uint widthStep = screenWidth / tiles;
-			uint heightStep = screenHeight / tiles;
-			
-			uint usingThreads = tiles * tiles;
-			vector<thread> tileThreads(usingThreads);
-			uint createdThreads = 0;
-
-			for (uint i=0; i<tiles; i++) {
-				uint xfrom = i * widthStep;
-				uint xto;
-				if (i == tiles - 1)	xto = screenWidth;	//the last tile
-				else					xto = (i+1) * widthStep;
-				for (uint j=0; j<tiles; j++) {
-					uint yfrom = j * heightStep;
-					uint yto;
-					if (j == tiles - 1)	yto = screenHeight;	//the last tile
-					else					yto = (j+1) * heightStep;
-
-					tileThreads[createdThreads++] = thread(&FractalCanvas::renderBitmapRect, this, highlight_guessed, xfrom, xto, yfrom, yto);
+		Before every tile, this checks if there's a newer bitmap render than bitmapRenderID, and if so it stops. That lets a new bitmap render start almost immediately, instead of waiting for older ones that are no longer needed. That makes a big difference when dragging the gradient sliders on a large canvas, which starts a new bitmap render for every movement.
+
+		Returns whether the whole bitmap was rendered.
+	*/
+	bool renderBitmapFull(bool highlight_guessed, bool multithreading, int bitmapRenderID)
+	{
+		const uint screenWidth = mP.width_resolution();
+		const uint screenHeight = mP.height_resolution();
+		const uint bitmap_zoom = mP.get_bitmap_zoom();
+
+		//the visible region in pixels of the resolution (not of the screen)
+		uint64 visible_xfrom, visible_xto, visible_yfrom, visible_yto;
+		{
+			lock_guard<mutex> guard(genericMutex);
+			visible_xfrom = min<uint64>(visible_x / bitmap_zoom, screenWidth);
+			visible_yfrom = min<uint64>(visible_y / bitmap_zoom, screenHeight);
+			visible_xto = min<uint64>(((uint64)visible_x + visible_width + bitmap_zoom - 1) / bitmap_zoom, screenWidth);
+			visible_yto = min<uint64>(((uint64)visible_y + visible_height + bitmap_zoom - 1) / bitmap_zoom, screenHeight);
+		}
+		//twice the center of the visible region, to stay with integers
+		const int64 center_x2 = visible_xfrom + visible_xto;
+		const int64 center_y2 = visible_yfrom + visible_yto;
+
+		struct BitmapTile {
+			uint xfrom, xto, yfrom, yto;
+			bool visible;
+			uint64 distance; //the squared distance to the center of the visible region, times 4
+		};
+		vector<BitmapTile> tiles;
+		for (uint yfrom = 0; yfrom < screenHeight; yfrom += BITMAP_TILE_SIZE)
+		for (uint xfrom = 0; xfrom < screenWidth; xfrom += BITMAP_TILE_SIZE)
+		{
+			BitmapTile tile;
+			tile.xfrom = xfrom;
+			tile.yfrom = yfrom;
+			tile.xto = min(screenWidth, xfrom + BITMAP_TILE_SIZE);
+			tile.yto = min(screenHeight, yfrom + BITMAP_TILE_SIZE);
+			tile.visible = tile.xfrom < visible_xto && tile.xto > visible_xfrom && tile.yfrom < visible_yto && tile.yto > visible_yfrom;
+			int64 dx = (int64)(tile.xfrom + tile.xto) - center_x2;
+			int64 dy = (int64)(tile.yfrom + tile.yto) - center_y2;
+			tile.distance = dx * dx + dy * dy;
+			tiles.push_back(tile);
+		}
+		sort(tiles.begin(), tiles.end(), [](const BitmapTile& a, const BitmapTile& b) {
+			if (a.visible != b.visible)
+				return a.visible;
+			return a.distance < b.distance;
+		});
+
+		atomic<uint> next_tile{ 0 };
+		atomic<bool> cancelled{ false };
+
+		auto renderTiles = [&]() {
+			for (uint i = next_tile++; i < tiles.size(); i = next_tile++) {
+				if (lastBitmapRenderID != bitmapRenderID) {
+					cancelled = true;
+					return;
 				}
+				const BitmapTile& tile = tiles[i];
+				renderBitmapRect(highlight_guessed, tile.xfrom, tile.xto, tile.yfrom, tile.yto);
 			}
+		};
 
-			for (uint i=0; i<createdThreads; i++)
-				tileThreads[i].join();
-		}
-		else {
-			if(debug) cout << "using 1 thread for renderBitmapFull" << endl;
-			renderBitmapRect(highlight_guessed, 0, screenWidth, 0, screenHeight);
-		}	
+		//use multithreading for extra speed when there's no render active
+		uint usingThreads = multithreading ? min<uint>(number_of_threads, tiles.size()) : 1;
+		if(debug) cout << "using " << usingThreads << " threads for renderBitmapFull with " << tiles.size() << " tiles" << endl;
+
+		vector<thread> tileThreads;
+		for (uint i=1; i<usingThreads; i++)
+			tileThreads.push_back(thread(renderTiles));
+		renderTiles();
+		for (thread& t : tileThreads)
+			t.join();
+
+		if(debug) if (cancelled) cout << "bitmap render " << bitmapRenderID << " stopped because there's a newer bitmap render" << endl;
+		return ! cancelled;
+	}
+
+	bool renderBitmapFull(bool highlight_guessed, bool multithreading) {
+		return renderBitmapFull(highlight_guessed, multithreading, lastBitmapRenderID);
 	}
 
 
@@ -783,8 +1254,32 @@ public:
 		}
 	};
 
+	//Changes the width of the iteration counts if maxIters or the procedure needs that, see needs_wide_counts. Returns false if there's not enough memory.
+	bool updateCountWidth()
+	{
+		if (needs_wide_counts(mP) != wide_counts) {
+			//maxIters or the procedure has changed so much that the iteration counts need a different width. The bitmap render reads the counts, so it has to wait.
+			cancelBitmapRender();
+			lock_guard<mutex> guard(activeBitmapRender);
+			cout << "changing the iteration counts to " << (wide_counts ? 16 : 32) << " bits" << endl;
+			uint64 size = iters_allocated_size;
+			allocateIters(size, ! wide_counts);
+			if (iterationCounts == nullptr) {
+				//Allocating memory failed. Try to get back to the old width. That doesn't need more memory than before so it should work.
+				allocateIters(size, wide_counts);
+				return false;
+			}
+		}
+		return true;
+	}
+
 	void createNewRender(uint renderID)
 	{
+		if ( ! updateCountWidth()) {
+			cout << "Allocating memory failed. The render can't be started with maxIters " << mP.get_maxIters() << "." << endl;
+			return;
+		}
+
 		if(debug) {
 			int procedure_identifier = mP.get_procedure_identifier();
 			assert(procedure_identifier == mP.get_procedure().id);
@@ -809,7 +1304,7 @@ public:
 	}
 
 	void createNewRender() {
-		createNewRender(++lastRenderID);
+		createNewRender(newRenderID());
 	}
 
 	//
@@ -854,7 +1349,7 @@ public:
 		{
 			lock_guard<mutex> guard(genericMutex);
 			renderQueueSize++;
-			renderID = ++lastRenderID;
+			renderID = newRenderID();
 		}
 
 		//actually start the render
@@ -868,7 +1363,7 @@ public:
 	void createNewBitmapRender(bool highlight_guessed, uint bitmapRenderID)
 	{
 		bitmapRenderStartedEvent(bitmapRenderID);
-		renderBitmapFull(highlight_guessed, true);
+		renderBitmapFull(highlight_guessed, true, bitmapRenderID);
 		bitmapRenderFinishedEvent(bitmapRenderID);
 	}
 
@@ -928,70 +1423,5 @@ public:
 	}
 };
 
-void saveImage(FractalCanvas* canvas, string filename, bool cleanup = true) {
-	uint width_resolution = canvas->P().width_resolution();
-	uint height_resolution = canvas->P().height_resolution();
-	uint bitmap_zoom = canvas->P().get_bitmap_zoom();
-
-	//
-	//	These loops performs conversion.
-	//
-	//	PNG requires RGBA-values in big-endian order. The colors in this program are ARGB stored in little-endian order. Lodepng interprets the data correctly when delivered as ABGR (the reserve order of RGBA) because of the endianness difference. This comes down to swapping red and blue.
-	//	 
-	//	 I convert the colors to ABGR in the original array to reduce memory usage. That means that after saving the PNG, the colors may need to be reverted to their original values.
-	//
-	if (bitmap_zoom > 1)
-	{
-		//I don't want to save the zoomed bitmap. This loop uses the existing array (which is large enough) to create an unzoomed bitmap.
-		for (uint y=0; y< height_resolution; y++)
-		for (uint x=0; x< width_resolution; x++)
-		{
-			uint pixelIndex = canvas->pixelIndex_of_pixelXY(x, y);
-			const ARGB pixel = canvas->ptPixels[pixelIndex];
-			canvas->ptPixels[width_resolution * y + x] = rgb(pixel.B, pixel.G, pixel.R);
-		}
-	}
-	else
-	{
-		for (uint y=0; y< height_resolution; y++)
-		for (uint x=0; x< width_resolution; x++)
-		{
-			uint pixelIndex = canvas->pixelIndex_of_pixelXY(x, y);
-			ARGB& pixel = canvas->ptPixels[pixelIndex];
-			pixel = rgb(pixel.B, pixel.G, pixel.R);
-		}
-	}
-
-	
-	uint8* out;
-	size_t outsize;
-	uint errorcode = lodepng_encode32(
-		&out, &outsize				//will contain the PNG data
-		,(uint8*)canvas->ptPixels	//image data to encode
-		, width_resolution, height_resolution	//width and height
-	);
-	if (errorcode != 0) {
-		cout << "error " << errorcode << " occurred while encoding PNG" << endl;
-		assert(false);
-	}
-	else {
-		ofstream outfile;
-		outfile.open(filename, ios::binary);
-		if (outfile.is_open()) {
-			outfile.write((char*)out, outsize);
-			outfile.close();
-		}
-		else {
-			cout << "error while opening file " << filename << endl;
-			assert(false);
-		}
-	}
-	free(out);
-
-	if (cleanup) {
-		canvas->createNewBitmapRender(false);
-	}
-}
-
 
 #endif
\ No newline at end of file
@@ -23,6 +23,9 @@
 #include "rapidjson/document.h"     // rapidjson's DOM-style API
 #include "rapidjson/prettywriter.h" // for stringify JSON
 
+//standard library
+#include <memory>
+
 //this program
 #include "common.cpp"
 #include "utilities.cpp"
@@ -34,6 +37,40 @@ public: inline const type& get_trick(name)() const {\
 	return name;\
 }
 
+/*
+	A vector that is shared by copies of the object that contains it until one of them changes it (copy on write). Copying it only copies a pointer.
+
+	FractalParameters are copied a lot: every history item is a copy, changeParameters tests changes on a copy and a new tab can start with a copy. The inflection coordinates and the gradient colors are the only members that are large, so those are stored like this.
+	A Render shares the vector from its own thread while the parameters can be changed (see changeParameters), so the pointer is an AtomicSharedPtr.
+*/
+template <typename T>
+class SharedVector {
+	AtomicSharedPtr<vector<T>> data;
+
+public:
+	SharedVector(size_t size = 0)
+	: data(make_shared<vector<T>>(size))
+	{}
+
+	//The references stay valid because only the object that owns this replaces the vector.
+	inline const vector<T>& read() const { return *data.load(); }
+	inline const T& operator[](size_t i) const { return read()[i]; }
+	inline size_t size() const { return read().size(); }
+
+	//for users that need the vector to stay valid while the parameters change, like a Render
+	inline shared_ptr<const vector<T>> share() const { return data.load(); }
+
+	//The vector to make changes to. The other objects that use the same vector keep the old values.
+	vector<T>& write() {
+		shared_ptr<vector<T>> current = data.load();
+		if (current.use_count() > 2) { //there are other users than this and current
+			current = make_shared<vector<T>>(*current);
+			data.store(current);
+		}
+		return *current;
+	}
+};
+
 /*
 	contains more than just the parameters. It also contains some values that aren't stricyly necessary to store but that make calculations more efficient. The function toJson creates a JSON representation that contains only the strictly necessary values. fromJson does the same in the other direction.
 
@@ -106,7 +143,7 @@ public:
 		else				return res;
 	}
 
-	//The actual size of the bitmap
+	//The size of the fractal on the screen. The bitmap in memory has the size of the resolution. It's enlarged by bitmap_zoom when it's drawn.
 	inline uint width_bitmap() const {
 		return width_resolution() * bitmap_zoom;
 	}
@@ -135,6 +172,9 @@ public:
 	//Formula: topleftCorner = center - x_range / 2 + (y_range / 2) * I
 	readonly(double_c, topleftCorner)
 
+	//the number of rows of points above the canvas, see restrictToBand
+	readonly(uint, band_offset)
+
 	readonly(uint, maxIters)
 
 	readonly(bool, julia)
@@ -144,7 +184,9 @@ public:
 	readonly(int, procedure_identifier)
 	public: Procedure get_procedure() const { return getProcedureObject(procedure_identifier); }
 	
-	readonly(vector<double_c>, inflectionCoords);//the locations of created Julia morphings
+	private: SharedVector<double_c> inflectionCoords; //the locations of created Julia morphings
+	public: inline const vector<double_c>& get_inflectionCoords() const { return inflectionCoords.read(); }
+	public: inline shared_ptr<const vector<double_c>> share_inflectionCoords() const { return inflectionCoords.share(); }
 	readonly(uint, inflectionCount)
 	readonly(double, inflectionZoomLevel) //reset to this zoom level upon creating a new inflection
 
@@ -152,7 +194,8 @@ public:
 	readonly(double, gradientOffset)
 	readonly(double, gradientSpeedFactor) //stored for efficiency
 	readonly(double, gradientOffsetTerm) //stored for efficiency
-	readonly(vector<ARGB>, gradientColors)
+	private: SharedVector<ARGB> gradientColors;
+	public: inline const vector<ARGB>& get_gradientColors() const { return gradientColors.read(); }
 
 	readonly(double, rotation_angle) //angle between 0 and 1. 0 means 0 degrees. 0.25 means 90 degrees etc.
 	readonly(double_c, center_of_rotation)
@@ -220,18 +263,14 @@ public:
 	}
 
 	bool setGradientColors(const vector<ARGB>& colors) {
-		bool changed = false;
-		if (gradientColors.size() != colors.size()) {
-			gradientColors.resize(colors.size());
-			changed = true;
-		}
-		for (int i=0; i<colors.size(); i++) {
-			ARGB& old = gradientColors[i];
-			const ARGB& new_ = colors[i];
-			if (bitcast<uint32>(old) != bitcast<uint32>(new_))
+		bool changed = gradientColors.size() != colors.size();
+		for (int i=0; i<colors.size() && ! changed; i++) {
+			if (bitcast<uint32>(gradientColors[i]) != bitcast<uint32>(colors[i]))
 				changed = true;
-			old = new_;
 		}
+		//Only write when something changed, so that the colors stay shared with copies of the parameters.
+		if (changed)
+			gradientColors.write() = colors;
 		modifiedColors |= changed;
 		return changed;
 	}
@@ -294,6 +333,11 @@ private:
 		changed |= setCoordinates(newCenter);
 		changed |= update_spacing();
 
+		if (band_offset != 0) {
+			band_offset = 0;
+			changed = true;
+		}
+
 		assert(x_range > 0);
 		assert(y_range > 0);
 
@@ -379,7 +423,7 @@ public:
 	inline double_c map(uint xPos, uint yPos) const {
 		assert(xPos >= 0); assert(xPos <= width_canvas());
 		assert(yPos >= 0); assert(yPos <= height_canvas());
-		return topleftCorner + xPos * x_spacing - yPos * y_spacing*I;
+		return topleftCorner + xPos * x_spacing - (yPos + band_offset) * y_spacing*I;
 	}
 
 	inline double_c rotation(double_c c) const {
@@ -410,6 +454,9 @@ public:
 				return log(c);
 			case 7:
 				return pow(c - partialInflectionCoord, partialInflectionPower) + partialInflectionCoord;
+			case 8:
+				//exponential map around partialInflectionCoord: the real part of c is the logarithm of the distance to it and the imaginary part the angle. This is used for zoom videos.
+				return exp(c) + partialInflectionCoord;
 		}
 		assert(false);
 		return 0;
@@ -491,6 +538,21 @@ public:
 		return changed;
 	}
 
+	/*
+		Changes the parameters into those of a horizontal band of the image: rows rows of pixels, starting at first_row. This is used to render an image in parts, see renderImageInBands.
+		Only the height changes. The center, ranges and topleftCorner remain those of the whole image and map adds band_offset to the y-coordinate, so that the points in the band are mapped to exactly the same complex numbers as in the whole image.
+		Changing the size, center or zoom level afterwards undoes this, so this should be done last.
+	*/
+	void restrictToBand(uint first_row, uint rows) {
+		assert(rows > 0);
+		assert(first_row + rows <= height_resolution());
+		band_offset = first_row * oversampling;
+		target_height = rows * bitmap_zoom;
+		modifiedMemory = true;
+		modifiedSize = true;
+		modifiedCalculations = true;
+	}
+
 	void setJulia(bool julia)
 	{
 		if (this->julia != julia)
@@ -568,12 +630,13 @@ public:
 	}
 
 	void addInflection(double_c c) {
-		while (inflectionCount >= inflectionCoords.size()) {
-			cout << "inflectionCount: " << inflectionCount << "    inflectionCoords.size(): " << inflectionCoords.size() << endl;
-			inflectionCoords.resize(inflectionCoords.size() * 2 + 1);
+		vector<double_c>& coords = inflectionCoords.write();
+		while (inflectionCount >= coords.size()) {
+			cout << "inflectionCount: " << inflectionCount << "    inflectionCoords.size(): " << coords.size() << endl;
+			coords.resize(coords.size() * 2 + 1);
 			modifiedMemory = true;
 		}
-		inflectionCoords[inflectionCount] = c;
+		coords[inflectionCount] = c;
 		inflectionCount++;
 		double oldAngle = rotation_angle;
 		setRotation(0);
@@ -595,15 +658,18 @@ public:
 		bool changed = false;
 		if (this->inflectionCount != inflectionCount) {
 			changed = true;
-			inflectionCoords = inflections;
+			inflectionCoords.write() = inflections;
 			this->inflectionCount = inflectionCount;
 		}
 		else {
-			for (uint i=0; i<inflectionCount; i++) {
+			for (uint i=0; i<inflectionCount && ! changed; i++) {
 				if (inflectionCoords[i] != inflections[i])
 					changed = true;
-
-				inflectionCoords[i] = inflections[i];
+			}
+			if (changed) {
+				vector<double_c>& coords = inflectionCoords.write();
+				for (uint i=0; i<inflectionCount; i++)
+					coords[i] = inflections[i];
 			}
 		}
 
@@ -668,6 +734,7 @@ public:
 			target_height = 800;
 			oversampling = 1;
 			bitmap_zoom = 1;
+			band_offset = 0;
 			rotation_angle = 0;
 			rotation_factor = 1;
 			procedure = M2;
@@ -680,11 +747,12 @@ public:
 		
 			post_transformation_type = 0;
 			pre_transformation_type = 0;
-			gradientColors.resize(4);
-			gradientColors[0] = rgb(255, 255, 255);
-			gradientColors[1] = rgb(52, 140, 167);
-			gradientColors[2] = rgb(0, 0, 0);
-			gradientColors[3] = rgb(220, 159, 57);
+			gradientColors.write() = {
+				rgb(255, 255, 255)
+				,rgb(52, 140, 167)
+				,rgb(0, 0, 0)
+				,rgb(220, 159, 57)
+			};
 			gradientSpeed = 1;
 			gradientOffset = 0.5;
 			partialInflectionCoord = 0;
@@ -711,6 +779,7 @@ public:
 			target_height = 800;
 			oversampling = 1;
 			bitmap_zoom = 1;
+			band_offset = 0;
 			rotation_angle = 0;
 			rotation_factor = 1;
 			procedure = M2;
@@ -759,6 +828,13 @@ public:
 		setCenterAndZoomAbsolute(P.get_center(), P.get_zoomLevel());
 		setMaxIters(P.get_maxIters());
 		setInflectionZoomLevel(P.get_inflectionZoomLevel());
+		//setCenterAndZoomAbsolute moves the center through the rotation around the old center, which isn't exact. The position is copied as it is in P, so that the points are exactly the same.
+		if (center != P.get_center() || topleftCorner != P.get_topleftCorner() || center_of_rotation != P.get_center_of_rotation()) {
+			center = P.get_center();
+			topleftCorner = P.get_topleftCorner();
+			center_of_rotation = P.get_center_of_rotation();
+			modifiedCalculations = true;
+		}
 	}
 
 	string toJson() const {
@@ -0,0 +1,143 @@
+/*
+    ExploreFractals, a tool for testing the effect of Mandelbrot set Julia morphings
+    Copyright (C) 2021  DinkydauSet
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMEMANIFEST_H
+#define FRAMEMANIFEST_H
+
+//standard library
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <filesystem>
+
+//this program
+#include "common.cpp"
+#include "FractalParameters.cpp"
+#include "StreamingImage.cpp"
+#include "utilities.cpp"
+
+//The CRC32 of a file. Returns false if the file can't be read.
+bool fileChecksum(string filename, uint& checksum)
+{
+	ifstream file(filename, ios::binary);
+	if ( ! file.is_open())
+		return false;
+	vector<char> buffer(1 << 20);
+	checksum = 0;
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		checksum = update_crc32(checksum, (const uint8*)buffer.data(), (size_t)file.gcount());
+	}
+	return file.eof();
+}
+
+//The CRC32 of the parameters, to recognize a frame of the same animation
+uint parametersChecksum(const FractalParameters& P)
+{
+	string json = P.toJson();
+	return update_crc32(0, (const uint8*)json.data(), json.size());
+}
+
+//Which frames of an animation are rendered
+struct FrameSelection {
+	int skipframes = 0; //the number of frames at the start that are skipped
+	int first = 1; //the first and last frame number to render. last 0 means up to the end.
+	int last = 0;
+	uint shard = 1; //render only the frames of shard number shard of shard_count: every shard_count-th frame
+	uint shard_count = 1;
+	bool verify_completed = false; //check the checksums of the frames that the manifest lists as completed, instead of only their sizes
+
+	bool contains(int number) const {
+		return number > skipframes
+			&& number >= first
+			&& (last == 0 || number <= last)
+			&& (uint)(number - 1) % shard_count == shard - 1;
+	}
+};
+
+/*
+	A list of the completed frames of an animation, so that an animation render can be continued where it stopped.
+
+	Every line is the name of a frame file, the checksum of the parameters of the frame, the checksum of the file (both in hexadecimal) and the size of the file:
+		frame000001.png 1a2b3c4d 5e6f7a8b 123456
+	A line is added when a frame has been saved. A frame is completed if there's a line for it with the same parameters and the file still has that size. That way, an unfinished file or a frame of another animation in the same directory is rendered again. Reading every file to compare the checksum is slow for a long animation, so that's only done on request (see FrameSelection::verify_completed).
+
+	Several processes can render parts of the same animation (see --shard) to the same directory with the same manifest, see appendLine.
+*/
+class FrameManifest {
+	string directory;
+	string filename;
+
+	struct Entry {
+		uint parameters_checksum;
+		uint file_checksum;
+		uint64 file_size; //0 in manifests from before the size was added, which are verified with the checksum
+	};
+	map<string, Entry> entries; //the frames that were completed when the manifest was read
+
+public:
+	FrameManifest(string directory, string name = "frames.manifest")
+	: directory(directory)
+	, filename(directory + name)
+	{
+		ifstream file(filename);
+		string line;
+		while (getline(file, line)) {
+			std::istringstream fields(line);
+			string frame;
+			Entry entry;
+			if (fields >> frame >> hex >> entry.parameters_checksum >> entry.file_checksum) {
+				if ( ! (fields >> dec >> entry.file_size))
+					entry.file_size = 0;
+				entries[frame] = entry; //a later line for the same frame replaces an earlier one
+			}
+		}
+		if(debug) cout << "read " << entries.size() << " frames from manifest " << filename << endl;
+	}
+
+	bool isCompleted(string frame, uint parameters_checksum, bool verify = false)
+	{
+		auto it = entries.find(frame);
+		if (it == entries.end() || it->second.parameters_checksum != parameters_checksum)
+			return false;
+		const Entry& entry = it->second;
+		std::error_code error;
+		uint64 size = filesystem::file_size(directory + frame, error);
+		if (error || (entry.file_size != 0 && size != entry.file_size))
+			return false;
+		if ( ! verify && entry.file_size != 0)
+			return true;
+		uint checksum;
+		return fileChecksum(directory + frame, checksum) && checksum == entry.file_checksum;
+	}
+
+	//Records that the file frame is completed. This can be used from several threads.
+	void add(string frame, uint parameters_checksum, uint file_checksum)
+	{
+		std::error_code error;
+		uint64 size = filesystem::file_size(directory + frame, error);
+		std::ostringstream line;
+		line << frame << " " << hex << setfill('0') << setw(8) << parameters_checksum << " " << setw(8) << file_checksum << " " << dec << (error ? 0 : size) << "\n";
+		if ( ! appendLine(filename, line.str()))
+			cout << "error while writing to the manifest " << filename << endl;
+	}
+};
+
+
+#endif
@@ -47,6 +47,8 @@
 #include "Render.cpp"
 #include "windows_util.cpp"
 #include "utilities.cpp"
+#include "StreamingImage.cpp"
+#include "IterationDataFile.cpp"
 #include "scrollpanel.cpp"
 
 
@@ -954,11 +956,13 @@ public:
 		hscrollbar.events().value_changed([&](const arg_scroll& arg)
 		{
 			offsetX = hscrollbar.value();
+			updateVisibleRegion();
 		});
 		vscrollbar.step(40);
 		vscrollbar.events().value_changed([&](const arg_scroll& arg)
 		{
 			offsetY = vscrollbar.value();
+			updateVisibleRegion();
 		});
 
 		//The resizing event takes place before the contents of the window are drawn. The resized event takes place afterwards.
@@ -1198,6 +1202,12 @@ public:
 		vscrollbar.range(fractal.size().height);
 		hscrollbar.amount(bitmapWidth);
 		vscrollbar.amount(bitmapHeight);
+		updateVisibleRegion();
+	}
+
+	//Bitmap renders start with the part of the fractal that's on the screen.
+	void updateVisibleRegion() {
+		canvas.setVisibleRegion(offsetX, offsetY, fractal.size().width, fractal.size().height);
 	}
 };
 
@@ -1395,7 +1405,7 @@ public:
 		string layout = R"(
 			<
 					       <progress min=45>
-				<weight=1> <time min=60>
+				<weight=1> <time min=150>
 				<weight=1> <inflections min=90>
 				<weight=1> <zoomlevel min=115>
 				<weight=1> <coordinates min=120>
@@ -1670,6 +1680,25 @@ public:
 					}
 				}
 			});
+			menu_.at(i).append("Save iteration data", [this](menu::item_proxy& ip)
+			{
+				if (activeCanvas != nullptr) {
+					string path = getDate() + " " + activeCanvas->P().get_procedure().name();
+					if (BrowseFile(getHwnd(), FALSE, "Save iteration data", "Iteration data\0*.efi\0\0", path)) {
+						saveIterationData(*activeCanvas, path);
+					}
+				}
+			});
+			menu_.at(i).append("Load iteration data", [this](menu::item_proxy& ip)
+			{
+				if (activeCanvas != nullptr) {
+					string path = "";
+					if (BrowseFile(getHwnd(), TRUE, "Load iteration data", "Iteration data\0*.efi\0\0", path)) {
+						if (loadIterationData(*activeCanvas, path))
+							activeCanvas->enqueueBitmapRender();
+					}
+				}
+			});
 			menu_.at(i).append("Save parameters as", [this](menu::item_proxy& ip)
 			{
 				saveParametersAs();
@@ -1829,9 +1858,6 @@ Fractalforums thread: https://fractalforums.org/other/55/explore-fractals-inflec
 			{
 				assert(activeFractalPanel != nullptr);
 
-				uint width = canvas->P().width_bitmap();
-				uint height = canvas->P().height_bitmap();
-
 				//where to draw
 				//The location to draw is the rectangle between the sidebar, sliders and scrollbars. Note that the viewport can be larger than the fractal bitmap, in which case not the whole viewport is used. This is handled correctly by bitblt.
 				nana::size viewport_size = activeFractalPanel->fractal.size();
@@ -1844,8 +1870,24 @@ Fractalforums thread: https://fractalforums.org/other/55/explore-fractals-inflec
 				//the bitmap containing the fractal's colors
 				paint::graphics& g = activeFractalPanel->bitmapManager->graph;
 
-				//copy part (possibly all) of the bitmap to the screen at the right position
-				graph.bitblt(draw_area, g, nana::point(offsetX, offsetY));
+				const uint bitmap_zoom = canvas->P().get_bitmap_zoom();
+				if (bitmap_zoom == 1) {
+					//copy part (possibly all) of the bitmap to the screen at the right position
+					graph.bitblt(draw_area, g, nana::point(offsetX, offsetY));
+				}
+				else {
+					//The bitmap has the size of the resolution, so it's enlarged here. The stretch algorithm is "proximal interpolation" (nearest neighbor), set in GUI_main, which makes every pixel a block of bitmap_zoom * bitmap_zoom pixels.
+					int x = offsetX / bitmap_zoom;
+					int y = offsetY / bitmap_zoom;
+					uint width = min<uint>(canvas->P().width_resolution() - x, (viewport_size.width + offsetX % bitmap_zoom + bitmap_zoom - 1) / bitmap_zoom);
+					uint height = min<uint>(canvas->P().height_resolution() - y, (viewport_size.height + offsetY % bitmap_zoom + bitmap_zoom - 1) / bitmap_zoom);
+					rectangle fromPart(nana::point(x, y), nana::size(width, height));
+					rectangle toPart(
+						nana::point(-(offsetX % (int)bitmap_zoom), -(offsetY % (int)bitmap_zoom))
+						,nana::size(width * bitmap_zoom, height * bitmap_zoom)
+					);
+					g.stretch(fromPart, graph, toPart);
+				}
 			}
 		});
 
@@ -2201,13 +2243,14 @@ Fractalforums thread: https://fractalforums.org/other/55/explore-fractals-inflec
 				paint::graphics viewport_copy;
 				API::window_graphics(viewport, viewport_copy);
 				paint::graphics& bitmap_graphics = fp->bitmapManager->graph;
+				//The bitmap has the size of the resolution, which is smaller than on the screen when bitmap_zoom > 1.
 				
 				if (zoomIn) {
 					rectangle fromPart(
 						nana::point(xPos - xPos / 4 - fp->offsetX, yPos - yPos / 4 - fp->offsetY)
 						,nana::size(bitmapWidth / 4,               bitmapHeight / 4)
 					);
-					rectangle toPart(nana::point(0, 0), nana::size(bitmapWidth, bitmapHeight));
+					rectangle toPart(nana::point(0, 0), nana::size(bitmapWidth / bitmap_zoom, bitmapHeight / bitmap_zoom));
 					viewport_copy.stretch(fromPart, bitmap_graphics, toPart);
 				}
 				else {
@@ -2216,8 +2259,8 @@ Fractalforums thread: https://fractalforums.org/other/55/explore-fractals-inflec
 						,nana::size(bitmapWidth,     bitmapHeight)
 					);
 					rectangle toPart(
-						nana::point(xPos - xPos / 4,    yPos - yPos / 4)
-						,nana::size(bitmapWidth / 4,    bitmapHeight / 4)
+						nana::point((xPos - xPos / 4) / bitmap_zoom,    (yPos - yPos / 4) / bitmap_zoom)
+						,nana::size(bitmapWidth / 4 / bitmap_zoom,      bitmapHeight / 4 / bitmap_zoom)
 					);
 					viewport_copy.stretch(fromPart, bitmap_graphics, toPart);
 				}
@@ -2290,13 +2333,15 @@ Fractalforums thread: https://fractalforums.org/other/55/explore-fractals-inflec
 	}
 
 	
-	void renderProgress(FractalCanvas* canvas, double progressPct, bool complete, double elapsedSeconds)
+	void renderProgress(FractalCanvas* canvas, double progressPct, bool complete, double elapsedSeconds, uint64 computedIterations)
 	{
 		int index = tabs.indexOf(canvas);
 		TabStatusbarLabels& labels = tabs.statusbarLabels[index];
 
 		stringstream ssElapsed;
 		ssElapsed << setprecision(5) << elapsedSeconds << " s";
+		if (elapsedSeconds > 0)
+			ssElapsed << ", " << setprecision(4) << computedIterations / elapsedSeconds / 1000000 << " Miter/s";
 			
 		stringstream ssProgress;
 		if (complete)
@@ -3003,7 +3048,7 @@ int GUI_main(FractalParameters& defaultParameters, uint number_of_threads, Fract
 		{
 			RenderInterface::ProgressInfo progress = render->getProgress();
 			assert(progress.ended);
-			fm.renderProgress(canvas, 100, true, progress.elapsedTime);
+			fm.renderProgress(canvas, 100, true, progress.elapsedTime, progress.computedIterations);
 			fm.drawBitmap(canvas);
 		}
 
@@ -3084,7 +3129,7 @@ int GUI_main(FractalParameters& defaultParameters, uint number_of_threads, Fract
 			uint renderSize = render->getWidth() * render->getHeight();
 			double progressPct = (double)(progress.guessedPixelCount + progress.calculatedPixelCount) / renderSize * 100;
 
-			fm.renderProgress(canvas, progressPct, progress.ended, progress.elapsedTime);
+			fm.renderProgress(canvas, progressPct, progress.ended, progress.elapsedTime, progress.computedIterations);
 		}
 		return false;
 	});
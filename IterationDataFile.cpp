@@ -0,0 +1,210 @@
+/*
+    ExploreFractals, a tool for testing the effect of Mandelbrot set Julia morphings
+    Copyright (C) 2021  DinkydauSet
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ITERATIONDATAFILE_H
+#define ITERATIONDATAFILE_H
+
+//standard library
+#include <fstream>
+
+//this program
+#include "common.cpp"
+#include "FractalParameters.cpp"
+#include "FractalCanvas.cpp"
+#include "utilities.cpp"
+
+/*
+	Iteration data files (.efi) contain the iteration data of a render together with its parameters, so that a render can be colored again (with other gradient settings) without calculating it again.
+
+	The file is:
+		the header below
+		the parameters as JSON, the same as in a parameter file
+		the iteration counts, exactly as FractalCanvas has them in memory
+		the flags, also as in memory
+
+	The counts and flags start at a multiple of ITERATION_DATA_ALIGNMENT bytes, so that they can be memory mapped (on Windows the offset has to be a multiple of 64 KB). Loading maps them instead of reading them, so it takes the same time for any file size. The data is read from the disk when it's used.
+
+	Because the data is stored as it is in memory, the layout (blocked or pixel-major) of the canvas has to be the same as in the file. The data isn't compressed, because then it couldn't be mapped. The blocked layout does keep neighboring points together in 16x16 tiles, so a recolor of a part of the image reads only that part of the file.
+*/
+constexpr char ITERATION_DATA_MAGIC[8] = { 'E', 'F', 'I', 'T', 'E', 'R', 'S', '\0' };
+constexpr uint ITERATION_DATA_VERSION = 1;
+constexpr uint64 ITERATION_DATA_ALIGNMENT = 1 << 16;
+
+struct IterationDataHeader {
+	char magic[8];
+	uint32 version;
+	uint32 wide_counts; //1 if the counts are 32 bits, 0 if they're 16 bits
+	uint32 blocked_layout; //1 for the blocked layout, 0 for the pixel-major layout
+	uint32 width_canvas;
+	uint32 height_canvas;
+	uint32 reserved;
+	uint64 points; //the size of the iteration data, which can be more than width_canvas * height_canvas in the blocked layout
+	uint64 json_offset;
+	uint64 json_size;
+	uint64 counts_offset;
+	uint64 counts_size;
+	uint64 flags_offset;
+	uint64 flags_size;
+};
+
+inline uint64 alignIterationData(uint64 offset) {
+	return (offset + ITERATION_DATA_ALIGNMENT - 1) & ~(ITERATION_DATA_ALIGNMENT - 1);
+}
+
+/*
+	Saves the iteration data and parameters of the canvas. This waits until an active render is done.
+*/
+bool saveIterationData(FractalCanvas& canvas, string filename)
+{
+	lock_guard<mutex> guard(canvas.activeRender);
+	FractalCanvas::RawIterationData data = canvas.rawIterationData();
+	if (data.counts == nullptr) {
+		cout << "there's no iteration data to save" << endl;
+		return false;
+	}
+	string json = canvas.P().toJson();
+
+	IterationDataHeader header = {};
+	memcpy(header.magic, ITERATION_DATA_MAGIC, sizeof(header.magic));
+	header.version = ITERATION_DATA_VERSION;
+	header.wide_counts = data.wide ? 1 : 0;
+	header.blocked_layout = canvas.blocked_layout ? 1 : 0;
+	header.width_canvas = canvas.P().width_canvas();
+	header.height_canvas = canvas.P().height_canvas();
+	header.points = data.points;
+	header.json_offset = sizeof(header);
+	header.json_size = json.size();
+	header.counts_offset = alignIterationData(header.json_offset + header.json_size);
+	header.counts_size = data.counts_size;
+	header.flags_offset = alignIterationData(header.counts_offset + header.counts_size);
+	header.flags_size = data.flags_size;
+
+	ofstream file(filename, ios::binary);
+	if ( ! file.is_open()) {
+		cout << "error while opening file " << filename << endl;
+		return false;
+	}
+	auto padTo = [&](uint64 offset) {
+		static const char zeros[4096] = {};
+		for (uint64 position = (uint64)file.tellp(); position < offset; ) {
+			uint64 amount = min<uint64>(sizeof(zeros), offset - position);
+			file.write(zeros, amount);
+			position += amount;
+		}
+	};
+	file.write((const char*)&header, sizeof(header));
+	file.write(json.data(), json.size());
+	padTo(header.counts_offset);
+	file.write((const char*)data.counts, data.counts_size);
+	padTo(header.flags_offset);
+	file.write((const char*)data.flags, data.flags_size);
+	file.close();
+
+	if ( ! file.good()) {
+		cout << "error while writing to file " << filename << endl;
+		return false;
+	}
+	cout << "saved iteration data " << filename << endl;
+	return true;
+}
+
+/*
+	Loads an iteration data file into the canvas: the parameters are applied and the canvas uses the (memory mapped) iteration data of the file. The bitmap isn't rendered.
+*/
+bool loadIterationData(FractalCanvas& canvas, string filename)
+{
+	ifstream file(filename, ios::binary | ios::ate);
+	if ( ! file.is_open()) {
+		cout << "error while opening file " << filename << endl;
+		return false;
+	}
+	uint64 file_size = (uint64)file.tellg();
+	file.seekg(0);
+
+	IterationDataHeader header;
+	if (file_size < sizeof(header) || ! file.read((char*)&header, sizeof(header))) {
+		cout << filename << " is not an iteration data file" << endl;
+		return false;
+	}
+	if (memcmp(header.magic, ITERATION_DATA_MAGIC, sizeof(header.magic)) != 0) {
+		cout << filename << " is not an iteration data file" << endl;
+		return false;
+	}
+	if (header.version != ITERATION_DATA_VERSION) {
+		cout << filename << " has version " << header.version << " which is not supported" << endl;
+		return false;
+	}
+	if (
+		header.json_offset + header.json_size > file_size
+		|| header.counts_offset + header.counts_size > file_size
+		|| header.flags_offset + header.flags_size > file_size
+		|| header.counts_offset % ITERATION_DATA_ALIGNMENT != 0
+		|| header.flags_offset % ITERATION_DATA_ALIGNMENT != 0
+	) {
+		cout << filename << " is damaged" << endl;
+		return false;
+	}
+	if ((header.blocked_layout == 1) != canvas.blocked_layout) {
+		cout << filename << " has the " << (header.blocked_layout ? "blocked" : "pixel") << " layout. Use --layout " << (header.blocked_layout ? "blocked" : "pixel") << " to load it." << endl;
+		return false;
+	}
+
+	string json(header.json_size, '\0');
+	file.seekg(header.json_offset);
+	file.read(&json[0], header.json_size);
+	file.close();
+
+	FractalParameters P = canvas.P();
+	if (readParametersJson(P, json) != ReadResult::succes) {
+		cout << "the parameters in " << filename << " can't be read" << endl;
+		return false;
+	}
+	if (
+		P.width_canvas() != header.width_canvas
+		|| P.height_canvas() != header.height_canvas
+		|| canvas.iters_size(P.width_canvas(), P.height_canvas()) != header.points
+		|| header.counts_size < header.points * (header.wide_counts ? sizeof(uint32) : sizeof(uint16)) + 32
+		|| header.flags_size < (header.points + 3) / 4 + 4
+	) {
+		cout << filename << " is damaged" << endl;
+		return false;
+	}
+
+	PooledBuffer counts, flags;
+	if ( ! bufferPool.mapFile(counts, filename, header.counts_offset, header.counts_size)
+		|| ! bufferPool.mapFile(flags, filename, header.flags_offset, header.flags_size)
+	) {
+		cout << "error while mapping " << filename << " to memory" << endl;
+		bufferPool.release(counts);
+		bufferPool.release(flags);
+		return false;
+	}
+
+	ResizeResult res = canvas.changeParameters(P);
+	if ( ! res.success) {
+		bufferPool.release(counts);
+		bufferPool.release(flags);
+		return false;
+	}
+	canvas.adoptIterationData(counts, flags, header.wide_counts == 1);
+	cout << "loaded iteration data " << filename << endl;
+	return true;
+}
+
+
+#endif
@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <stack>
 #include <condition_variable>
+#include <atomic>
 
 //Intrinsics, for using avx instructions
 #include <intrin.h>
@@ -41,6 +42,27 @@ constexpr bool CALCULATED = false;
 constexpr bool GUESSED = true;
 
 
+/*
+	Counters of the work done by one thread of a render. Every thread has its own counters, so they can be increased without locking. They're on their own cache line, otherwise threads that increase their counters at the same time would slow each other down (false sharing).
+
+	Only the thread that owns the counters changes them. They're atomic so that the GUI can read the progress during the render.
+*/
+struct alignas(64) WorkerCounters {
+	atomic<uint64> iterations{ 0 }; //the iterations that were actually executed
+	atomic<uint64> guessed{ 0 };
+	atomic<uint64> calculated{ 0 };
+	atomic<uint64> pixelGroupings{ 0 };
+	//how well the 4 lanes of calcPointVectorAVX_M2 are used: the steps of the vector loop and the iterations of the points that are finished without AVX
+	atomic<uint64> avxSteps{ 0 };
+	atomic<uint64> avxTailIterations{ 0 };
+
+	//This is not an atomic increment, which isn't needed because there's only one writer.
+	static void add(atomic<uint64>& counter, uint64 n) {
+		counter.store(counter.load(memory_order_relaxed) + n, memory_order_relaxed);
+	}
+};
+
+
 /*
 	Escape radius for Mandelbrot power n is: pow(2, 1/(n-1))
 	Squared that's pow(2, 2/(n-1)). Using the squared esacape radius is more efficient for calculations.
@@ -131,13 +153,16 @@ public:
 	Render(FractalCanvas& canvasContext, uint renderID)
 		: canvas(canvasContext)
 		, renderID(renderID)
-		, inflectionCoords(canvas.P().get_inflectionCoords())
+		, inflectionCoordsData(canvas.P().share_inflectionCoords())
+		, inflectionCoords(*inflectionCoordsData)
 		, width(canvas.P().width_canvas())
 		, height(canvas.P().height_canvas())
 		, oversampling(canvas.P().get_oversampling())
 		, juliaSeed(canvas.P().get_juliaSeed())
 		, maxIters(canvas.P().get_maxIters())
 		, inflectionCount(canvas.P().get_inflectionCount())
+		, algorithm(canvas.render_algorithm)
+		, counterSlots(1 + canvas.number_of_threads)
 		//, work_distribution(canvasContext, (use_avx ? 4 : 1) * canvasContext.number_of_threads)
 	{
 		if(debug) cout << "creating render " << renderID << endl;
@@ -150,8 +175,11 @@ public:
 	FractalCanvas& canvas;
 	const uint renderID;
 	static constexpr Procedure procedure = getProcedureObject(procedure_identifier); //this value is known at compile time
+	//Boundary tracing only calculates the edges of the regions with the same iterationcount, so a region can't have an island with another count inside it. That holds for the Mandelbrot procedures. For the other procedures Mariani-Silver is used, which calculates the boundary of every tile.
+	static constexpr bool boundary_traceable = procedure.guessable && procedure.kind == ProcedureKind::Mandelbrot;
 
 	//some widely used members of canvas.P
+	const shared_ptr<const vector<double_c>> inflectionCoordsData; //The parameters can get a new vector during the render (see SharedVector). This keeps the one of the render.
 	const vector<double_c>& inflectionCoords;
 	const uint width;			uint getWidth() { return width; }
 	const uint height;			uint getHeight() { return height; }
@@ -159,18 +187,39 @@ public:
 	const double_c juliaSeed;
 	const uint maxIters;
 	const uint inflectionCount;
+	const RenderAlgorithm algorithm;
 	
 	//other
-	uint usedThreads{ 0 }; //counts the total number of threads created
 	uint threadCount{ 0 };
 	chrono::time_point<chrono::high_resolution_clock> startTime;
 	chrono::time_point<chrono::high_resolution_clock> endTime;
 	bool ended{ false };
+
+	//Slot 0 is for the thread that executes the render, slot 1 + k for worker thread k. The raster threads and the tile threads don't run at the same time, so they use the same slots. The counters are merged into the totals below when the render is finished.
+	vector<WorkerCounters> counterSlots;
+	inline static thread_local WorkerCounters* counters = nullptr; //the slot of the current thread
+
+	void useCounterSlot(uint slot) {
+		assert(slot < counterSlots.size());
+		counters = &counterSlots[slot];
+	}
+
 	uint64 guessedPixelCount{ 0 };
 	uint64 calculatedPixelCount{ 0 };
 	uint64 pixelGroupings{ 0 };
 	uint64 computedIterations{ 0 };
 
+	//for RenderStatistics
+	double rasterSeconds{ 0 };
+	double tileSeconds{ 0 };
+	atomic<uint64> bitmapNanoseconds{ 0 };
+	vector<WorkerStatistics> workers;
+	uint64 queueWaits{ 0 };
+	double queueWaitSeconds{ 0 };
+	atomic<uint64> tilesSplit{ 0 };
+	atomic<uint64> tilesFilled{ 0 };
+	atomic<uint64> tilesCalculated{ 0 };
+
 	//work distribution
 	//WorkDistribution work_distribution;
 
@@ -196,6 +245,7 @@ public:
 		uint iterLeft;
 		bool sameRight;
 		uint iterRight;
+		chrono::high_resolution_clock::time_point queued; //for queueWaitSeconds
 	};
 
 	stack<SilverWorkItem, vector<SilverWorkItem>> work_queue;
@@ -206,6 +256,7 @@ public:
 
 		bool was_empty = work_queue.empty();
 		work_queue.emplace(SilverWorkItem{args...});
+		work_queue.top().queued = chrono::high_resolution_clock::now();
 
 		if(debug) mtxprint("added to queue, new size: ", work_queue.size());
 
@@ -237,6 +288,7 @@ public:
 			}
 
 			queue_waiting_threads++;
+			queueWaits++;
 			work_queue_access.wait(changelock, [&, this]
 			{
 				return ! work_queue.empty() || no_more_work;
@@ -251,13 +303,24 @@ public:
 
 		ret.set( work_queue.top() );
 		work_queue.pop();
+		queueWaitSeconds += chrono::duration<double>(chrono::high_resolution_clock::now() - ret.v.queued).count();
 
 		return ret;
 	}
 
-	void renderSilverWorkLoop() {
+	void renderSilverWorkLoop(uint worker) {
+		useCounterSlot(1 + worker);
+		WorkerStatistics& stats = workers[worker];
+		auto time = chrono::high_resolution_clock::now();
+		auto secondsSinceTime = [&]() {
+			auto now = chrono::high_resolution_clock::now();
+			chrono::duration<double> elapsed = now - time;
+			time = now;
+			return elapsed.count();
+		};
 		while (true) {
 			nullable<SilverWorkItem> work = getFromQueue();
+			stats.idle_seconds += secondsSinceTime();
 			if (work.isnull) {
 				return;
 			}
@@ -265,10 +328,18 @@ public:
 				//There is new work. The thread is reused:
 				SilverWorkItem& w = work.v;
 				renderSilverRect(w.bitmap_render_responsibility, w.xmin, w.xmax, w.ymin, w.ymax, w.sameTop, w.iterTop, w.sameBottom, w.iterBottom, w.sameLeft, w.iterLeft, w.sameRight, w.iterRight);
+				stats.busy_seconds += secondsSinceTime();
 			}
 		}
 	}
 
+	//Colors pixels during the render, see FractalCanvas::renderBitmapRect
+	void renderBitmapRect(uint xfrom, uint xto, uint yfrom, uint yto) {
+		auto start = chrono::high_resolution_clock::now();
+		canvas.renderBitmapRect(false, xfrom, xto, yfrom, yto);
+		bitmapNanoseconds += chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+	}
+
 
 
 
@@ -328,7 +399,8 @@ public:
 			canvas.P().map(x, y)))));
 	}
 
-	uint calcPoint(uint x, uint y) {
+	//iterations is increased by the number of iterations that were executed, which can be different from the iterationcount of the point, for example inside the cardioid.
+	uint calcPoint(uint x, uint y, uint64& iterations) {
 		assert(x < width && y < height);
 		assert(x >= 0 && y >= 0);
 
@@ -484,6 +556,7 @@ public:
 				summ += abs(z);
 			}
 			iterationCount = (int)(summ);
+			iterations += maxIters > 2 ? maxIters - 2 : 0;
 			canvas.setPixel(x, y, iterationCount, CALCULATED, false);
 			return iterationCount;
 		}
@@ -610,10 +683,14 @@ public:
 					}
 				}
 			}
+			iterations += iterationCount;
 			canvas.setPixel(x, y, iterationCount, CALCULATED, false);
 			return iterationCount;
 		}
 
+		if constexpr(procedure_identifier != CHECKERS.id) {
+			iterations += iterationCount; //for RECURSIVE_FRACTAL this is the sum of both loops
+		}
 		canvas.setPixel(x, y, iterationCount, CALCULATED, iterationCount == maxIters);
 
 		return iterationCount;
@@ -629,8 +706,9 @@ public:
 				isSame = false; \
 		}
 
+	template <typename PointSource>
 	[[gnu::target("avx")]]
-	inline bool calcPointVectorAVX_M2(vector<point>& points, uint fromPoint, uint toPoint) {
+	inline bool calcPointVectorAVX_M2(const PointSource& points, uint fromPoint, uint toPoint, uint64& iterations) {
 		//AVX for Mandelbrot power 2
 		//AVX is used. Length 4 arrays and vectors are constructed to iterate 4 pixels at once. That means 4 x-values, 4 y-values, 4 c-values etc.
 		__m256d all_true = _mm256_cmp_pd(_mm256_set1_pd(1), _mm256_setzero_pd(), _CMP_NLE_UQ);
@@ -638,18 +716,14 @@ public:
 		uint thisIter = -1;
 		bool isSame = true; //whether all iteration counts of the pixels in this vector are the same
 
-		uint x[4] = {
-			points[fromPoint].x
-			,points[fromPoint + 1].x
-			,points[fromPoint + 2].x
-			,points[fromPoint + 3].x
-		};
-		uint y[4]{
-			points[fromPoint].y
-			,points[fromPoint + 1].y
-			,points[fromPoint + 2].y
-			,points[fromPoint + 3].y
+		point first[4] = {
+			points[fromPoint]
+			,points[fromPoint + 1]
+			,points[fromPoint + 2]
+			,points[fromPoint + 3]
 		};
+		uint x[4] = { first[0].x, first[1].x, first[2].x, first[3].x };
+		uint y[4] = { first[0].y, first[1].y, first[2].y, first[3].y };
 		double_c c[4] = {
 			map_with_transformations_m2(x[0], y[0])
 			,map_with_transformations_m2(x[1], y[1])
@@ -710,6 +784,7 @@ public:
 		}
 
 		bool continue_avx_iteration = true;
+		uint64 steps = 0;
 
 		while (true) {
 			if (
@@ -730,14 +805,16 @@ public:
 							//There is work left to do. The finished pixel needs to be replaced by a new one.
 
 							setPixelAndThisIter(x[k], y[k], iterationCounts[k], CALCULATED, iterationCounts[k] == maxIters); //set because the pixel was done
+							iterations += iterationCounts[k];
 							iterationCounts[k] = -1; //to mark pixel k in the vectors as done/invalid
 
 							bool pixelIsValid = false;
 
 							while (!pixelIsValid && nextPixel < toPoint) {
 								//take new pixel:
-								x[k] = points[nextPixel].x;
-								y[k] = points[nextPixel].y;
+								point p = points[nextPixel];
+								x[k] = p.x;
+								y[k] = p.y;
 								c[k] = map_with_transformations_m2(x[k], y[k]);
 								nextPixel++;
 
@@ -826,6 +903,7 @@ public:
 				for (int m = 0; m < 4; m++) {
 					iterationCounts[m]++;
 				}
+				steps++;
 
 				pixel_has_escaped_v = _mm256_xor_pd(
 					_mm256_cmp_pd(zisqr_plus_zrsqr_v, bailout_v, _CMP_LE_OQ)
@@ -836,6 +914,7 @@ public:
 		}
 
 		//Finish iterating the remaining 3 or fewer pixels without AVX:
+		uint64 tailIterations = 0;
 		for (int k = 0; k < 4; k++)
 		{
 			uint iterationCount = iterationCounts[k];
@@ -855,22 +934,47 @@ public:
 					zisqrd = zid * zid;
 					iterationCount++;
 				}
+				iterations += iterationCount;
+				tailIterations += iterationCount - iterationCounts[k];
 				setPixelAndThisIter(x[k], y[k], iterationCount, CALCULATED, iterationCount == maxIters);
 			}
 		}
+		WorkerCounters::add(counters->avxSteps, steps);
+		WorkerCounters::add(counters->avxTailIterations, tailIterations);
 		return isSame;
 	}
 //#pragma GCC pop_options
 	
 	#undef setPixelAndThisIter
 
+	/*
+		Point sources for calcPointVector. They describe which points to calculate without storing the points, so that calculating a line or a tile doesn't need any memory allocation. points[k] is the k-th point.
+	*/
+	struct HorizontalLine {
+		uint xFrom, y;
+		point operator[](uint k) const { return {xFrom + k, y}; }
+	};
+	struct VerticalLine {
+		uint x, yFrom;
+		point operator[](uint k) const { return {x, yFrom + k}; }
+	};
+	//the points in a rectangle, column by column
+	struct Rectangle {
+		uint xFrom, yFrom, height;
+		point operator[](uint k) const { return {xFrom + k / height, yFrom + k % height}; }
+	};
+	struct PointList {
+		const point* points;
+		point operator[](uint k) const { return points[k]; }
+	};
+
 	/*
 		including fromPoint; not including toPoint
 	*/
-	bool calcPointVector(vector<point>& points, uint fromPoint, uint toPoint) {
+	template <typename PointSource>
+	bool calcPointVector(const PointSource& points, uint fromPoint, uint toPoint) {
 		assert(fromPoint >= 0);
 		assert(toPoint >= fromPoint);
-		assert(points.size() > (toPoint-1));
 
 		if (renderID != canvas.lastRenderID) {
 			if(debug) cout << "Render " << renderID << " cancelled; terminating thread" << endl;
@@ -879,25 +983,29 @@ public:
 
 		uint pointCount = toPoint - fromPoint;
 		bool isSame = true;
+		if (pointCount == 0)
+			return true;
+
+		uint64 iterations = 0;
 
 		//if(true) { //todo: AVX always disabled for testing
 		if (!use_avx || procedure_identifier != M2.id || pointCount < 4) {
-			uint thisX = points[fromPoint].x;
-			uint thisY = points[fromPoint].y;
-			uint thisIter = calcPoint(thisX, thisY);
+			point p = points[fromPoint];
+			uint thisIter = calcPoint(p.x, p.y, iterations);
 
 			for (uint k = fromPoint + 1; k < toPoint; k++) {
-				assert(thisX < width); assert(thisY < height);
-				thisX = points[k].x;
-				thisY = points[k].y;
-				if (calcPoint(thisX, thisY) != thisIter) //calculates the point
+				p = points[k];
+				assert(p.x < width); assert(p.y < height);
+				if (calcPoint(p.x, p.y, iterations) != thisIter) //calculates the point
 					isSame = false;
 			}
 		}
 		else { 
-			isSame = calcPointVectorAVX_M2(points, fromPoint, toPoint);
+			isSame = calcPointVectorAVX_M2(points, fromPoint, toPoint, iterations);
 		}
-		calculatedPixelCount += pointCount;
+		assert(counters != nullptr);
+		WorkerCounters::add(counters->iterations, iterations);
+		WorkerCounters::add(counters->calculated, pointCount);
 		return isSame && procedure.guessable;
 	}
 
@@ -907,15 +1015,7 @@ public:
 	bool isSameHorizontalLine(uint xFrom, uint xTo, uint height) {
 		assert(xTo >= xFrom);
 		if constexpr(procedure.guessable) {
-			bool same = true;
-			uint thisIter = canvas.getIterationcount(xFrom, height);
-			for (uint x = xFrom + 1; x < xTo; x++) {
-				if (thisIter != canvas.getIterationcount(x, height)) {
-					same = false;
-					break;
-				}
-			}
-			return same;
+			return canvas.isSameHorizontalLine(xFrom, xTo, height);
 		}
 		else {
 			return false;
@@ -928,15 +1028,7 @@ public:
 	bool isSameVerticalLine(uint yFrom, uint yTo, uint width) {
 		assert(yTo >= yFrom);
 		if constexpr(procedure.guessable) {
-			bool same = true;
-			uint thisIter = canvas.getIterationcount(width, yFrom);
-			for (uint y = yFrom + 1; y < yTo; y++) {
-				if (thisIter != canvas.getIterationcount(width, y)) {
-					same = false;
-					break;
-				}
-			}
-			return same;
+			return canvas.isSameVerticalLine(yFrom, yTo, width);
 		}
 		else {
 			return false;
@@ -948,13 +1040,7 @@ public:
 	*/
 	bool calcHorizontalLine(uint xFrom, uint xTo, uint height) {
 		assert(xTo >= xFrom);
-		uint size = xTo - xFrom;
-		vector<point> hLine(size);
-		uint thisIndex = 0;
-		for (uint x = xFrom; x < xTo; x++) {
-			hLine[thisIndex++] = {x, height};
-		}
-		return calcPointVector(hLine, 0, thisIndex);
+		return calcPointVector(HorizontalLine{xFrom, height}, 0, xTo - xFrom);
 	}
 
 	/*
@@ -962,13 +1048,7 @@ public:
 	*/
 	bool calcVerticalLine(uint yFrom, uint yTo, uint width) {
 		assert(yTo >= yFrom);
-		uint size = yTo - yFrom;
-		vector<point> vLine(size);
-		uint thisIndex = 0;
-		for (uint y = yFrom; y < yTo; y++) {
-			vLine[thisIndex++] = {width, y};
-		}
-		return calcPointVector(vLine, 0, thisIndex);
+		return calcPointVector(VerticalLine{width, yFrom}, 0, yTo - yFrom);
 	}
 
 	/*
@@ -976,7 +1056,7 @@ public:
 
 		The bool inNewThread is only to keep track of the current number of threads.
 
-		bitmap_render_responsibility means that this tile should compute and set the colors of its pixels to the bitmap after it is finished. The function can pass the responsiblity on to subtiles through its recursive calls. It's not entirely clear how long the passing should continue for the best performance. When oversampling is used, it's important not to continue for too long because a tile can be smaller than a pixel. (Each pixel is a raster of oversamplingoversampling calculated points.) There would be double work done if every tile that has overlap with some pixel calculates its color. See the explanation of stop_creating_threads.
+		bitmap_render_responsibility means that this tile should compute and set the colors of its pixels to the bitmap after it is finished. The function can pass the responsiblity on to subtiles through its recursive calls. The responsibility is passed on as long as the subtiles are pixel aligned. When oversampling is used a tile can be smaller than a pixel. (Each pixel is a raster of oversamplingoversampling calculated points.) See the explanation of pixel aligned tiles below.
 	*/
 	void renderSilverRect(bool bitmap_render_responsibility, uint xmin, uint xmax, uint ymin, uint ymax, bool sameTop, uint iterTop, bool sameBottom, uint iterBottom, bool sameLeft, uint iterLeft, bool sameRight, uint iterRight)
 	{
@@ -990,19 +1070,19 @@ public:
 		uint size = (xmax - xmin - 1)*(ymax - ymin - 1); //the size of the part that still has to be calculated
 		
 		/*
-			This is to prevent creating new threads when the tile becomes so small that it's only a few pixels wide or high (fewer than NEW_TILE_THREAD_MIN_PIXELS).
+			Ownership of pixel colors. With oversampling a pixel is a raster of oversampling*oversampling calculated points. If two tiles that overlap with one pixel are calculated by different threads, it can happen that the color of that pixel is changed by 2 threads at the same time, leading to an incorrect result (or the color gets calculated before all points of the pixel are ready).
 			
-			The problem with threads at that scale has to do with oversampling. Oversampling means there are multiple calculated points per pixel. If two tiles overlap with one pixel, and both tiles are being calculated by different threads, it can happen that a pixel color value is changed by 2 threads at the same time, leading to an incorrect result. By not creating new threads, the subdivision into smaller tiles can continue safely.
-
-			 Increasing NEW_TILE_THREAD_MIN_PIXELS can improve performance by allowing for more optimal tile subdivision, but it also causes color values to be calculated in larger groups together making bitmap updates less frequent, and not allowing new threads too early means less usage of all CPU cores.
-
-			Note also that this is only necessary to show progress in the program. Without visible progress, calculating the color values could be postponed until after all the iteration counts have been calculated, but that's not user-friendly.
+			To prevent that, a tile is called pixel aligned if its left and top boundaries are at the start of a pixel and its right and bottom boundaries are also at the start of a pixel or at the last point of the canvas. Such a tile owns the pixel columns xmin/oversampling up to (not including) xmax/oversampling (or up to the last column if xmax is the last point), and the same for rows. The boundary points at xmax and ymax belong to the pixels of the neighboring tiles. Because those pixels are owned by exactly one tile, pixel aligned tiles can be calculated by any thread and set the colors of their own pixels without races.
+			
+			When a pixel aligned tile is split, the split line is rounded to a whole pixel so that both subtiles are pixel aligned again. That's only impossible when the tile is less than 2 pixels wide (or high). From there on the subtiles are not pixel aligned and all the work stays in this thread. This tile then keeps the bitmap_render_responsibility and sets the colors after the subtiles are finished.
+			
+			Without oversampling every tile is pixel aligned, so everything is stealable work down to the leaf size.
 		*/
-		bool stop_creating_threads =
-			(xmax - xmin) / oversampling < NEW_TILE_THREAD_MIN_PIXELS
-			|| (ymax - ymin) / oversampling < NEW_TILE_THREAD_MIN_PIXELS;
-
-		bool pass_on_bitmap_render_responsibility = bitmap_render_responsibility && !stop_creating_threads;
+		bool x_aligned = xmin % oversampling == 0 && (xmax % oversampling == 0 || xmax == width - 1);
+		bool y_aligned = ymin % oversampling == 0 && (ymax % oversampling == 0 || ymax == height - 1);
+		assert(!bitmap_render_responsibility || (x_aligned && y_aligned)); //only pixel aligned tiles can own pixels
+		bool split_aligned = false; //whether the subtiles of this tile are pixel aligned, which is decided below when the tile gets split
+		bool pass_on_bitmap_render_responsibility = false;
 
 		if constexpr(procedure.guessable) {
 			if (sameRight && sameLeft && sameTop && sameBottom && iterRight == iterTop && iterTop == iterLeft && iterLeft == iterBottom && iterRight != 1 && iterRight != 0) {
@@ -1013,33 +1093,29 @@ public:
 						canvas.setPixel(x, y, iterLeft, GUESSED, isInMinibrot);
 					}
 				}
-				guessedPixelCount += (xmax - xmin - 1)*(ymax - ymin - 1);
-				pass_on_bitmap_render_responsibility = false;
+				WorkerCounters::add(counters->guessed, (xmax - xmin - 1)*(ymax - ymin - 1));
+				tilesFilled++;
 				goto returnLabel;
 			}
 		}
 
 		if (size < MAXIMUM_TILE_SIZE) {
 			//The tile is now very small. Stop the recursion and iterate all pixels.
-			vector<point> toIterate(size);
-			uint thisIndex = 0;
-			for (uint x = xmin + 1; x < xmax; x++) {
-				for (uint y = ymin + 1; y < ymax; y++) {
-					toIterate[thisIndex++] = {x, y};
-				}
-			}
-			calcPointVector(toIterate, 0, thisIndex);
-			pass_on_bitmap_render_responsibility = false;
+			calcPointVector(Rectangle{xmin + 1, ymin + 1, ymax - ymin - 1}, 0, size);
+			tilesCalculated++;
 			goto returnLabel;
 		}
 
 		//The tile gets split up:
+		tilesSplit++;
 		if (xmax - xmin < ymax - ymin) {
 			//The tile is taller than it's wide. Split the tile with a horizontal line. The y-coordinate is:
 			uint y = ymin + (ymax - ymin) / 2;
-			if (!stop_creating_threads) {
+			split_aligned = x_aligned && y_aligned && y - (y%oversampling) > ymin;
+			if (split_aligned) {
 				y = y - (y%oversampling); //round to whole pixels
 			}
+			pass_on_bitmap_render_responsibility = bitmap_render_responsibility && split_aligned;
 
 			//compute new line
 			bool sameNewLine = calcHorizontalLine(xmin + 1, xmax, y);
@@ -1066,7 +1142,7 @@ public:
 
 			if (renderID == canvas.lastRenderID)
 			{
-				if (work_queue.empty() && !stop_creating_threads)
+				if (work_queue.empty() && split_aligned)
 				{
 					addToQueue(pass_on_bitmap_render_responsibility, xmin, xmax, ymin, y, sameTop, iterTop, sameNewLine, iterNewLine, sameLeftTop, iterLeftTop, sameRightTop, iterRightTop);
 
@@ -1088,9 +1164,11 @@ public:
 		else {
 			//The tile is wider than it's tall. Split the tile with a vertical line. The x-coordinate is:
 			uint x = xmin + (xmax - xmin) / 2;
-			if (!stop_creating_threads) {
+			split_aligned = x_aligned && y_aligned && x - (x%oversampling) > xmin;
+			if (split_aligned) {
 				x = x - (x%oversampling); //round to whole pixels
 			}
+			pass_on_bitmap_render_responsibility = bitmap_render_responsibility && split_aligned;
 
 			//Compute new line
 			bool sameNewLine = calcVerticalLine(ymin + 1, ymax, x);
@@ -1116,7 +1194,7 @@ public:
 			}
 			if (renderID == canvas.lastRenderID)
 			{
-				if (work_queue.empty() && !stop_creating_threads)
+				if (work_queue.empty() && split_aligned)
 				{
 					addToQueue(pass_on_bitmap_render_responsibility, xmin, x, ymin, ymax, sameLeftTop, iterLeftTop, sameLeftBottom, iterLeftBottom, sameLeft, iterLeft, sameNewLine, iterNewLine);
 
@@ -1148,10 +1226,10 @@ public:
 			assert(xfrom <= xto);
 			assert(yfrom <= yto);
 			
-			canvas.renderBitmapRect(false, xfrom, xto, yfrom, yto);
+			renderBitmapRect(xfrom, xto, yfrom, yto);
 		}
 		
-		pixelGroupings += 2;
+		WorkerCounters::add(counters->pixelGroupings, 2);
 	}
 
 	void renderSilverFull()
@@ -1168,8 +1246,8 @@ public:
 
 		uint tiles = (uint)(sqrt(canvas.number_of_threads)); //the number of tiles in both horizontal and vertical direction, so in total there are (tiles * tiles)
 
-		//It can happen that there are too many tiles with a high number of threads and a low resolution. The tiles should contain at least one point within their borders. The number of tiles is reduced accordingly, if needed. Because of the restriction, 3x3 is the smallest resolution that this tiling algorithm works for.
-		tiles = min({tiles, (width - 1)/2, (height-1)/2});
+		//It can happen that there are too many tiles with a high number of threads and a low resolution. The tiles should contain at least one point within their borders and at least one pixel, because the tiles need to be pixel aligned (see renderSilverRect). The number of tiles is reduced accordingly, if needed. Because of the restriction, 3x3 is the smallest resolution that this tiling algorithm works for.
+		tiles = min({tiles, (width - 1)/2, (height-1)/2, width / oversampling, height / oversampling});
 		if (tiles == 0) {
 			cout << "No render takes place. The tiling algorithm only works with a resolution of at least 3x3." << endl;
 			return;
@@ -1177,8 +1255,9 @@ public:
 
 		if(debug) cout << "renderSilverFull with tiles: " << tiles << endl;
 
-		uint widthStep = width / tiles;
-		uint heightStep = height / tiles;
+		//whole pixels, so that the tiles are pixel aligned
+		uint widthStep = (width / oversampling / tiles) * oversampling;
+		uint heightStep = (height / oversampling / tiles) * oversampling;
 
 		vector<bool> isSameList(2 * tiles*(tiles + 1));
 		vector<uint> heights(tiles + 1);
@@ -1191,67 +1270,77 @@ public:
 		heights[tiles] = ymax;
 		widths[tiles] = xmax;
 
-		//This vector is all pixels in the raster in (x-coord, y-coord) format: x-coords are at odd indices (0, 3, ....), y-coords at even indices
-		vector<point> rasterCoordinates((tiles + 1)*(height + width));
-		uint rasterCoordinateIndex = 0;
+		/*
+			The raster consists of lines. Every line is calculated with calcHorizontalLine or calcVerticalLine, which also tell if all points in the line have the same iterationcount, so that the raster doesn't have to be checked again afterwards.
 
-		uint thisHeight;
-		uint thisWidth;
-		for (uint lineNumH = 0; lineNumH < tiles; lineNumH++) {
-			for (uint lineNumV = 0; lineNumV < tiles; lineNumV++) {
-				thisHeight = heights[lineNumV];
-				thisWidth = widths[lineNumH];
-				for (uint k = widths[lineNumH] + 1; k < widths[lineNumH + 1]; k++) { // a '+ 1' here for initial k, because otherwise the next for-loop would calculate the same pixel again (this only saves calculating typically 4 - 16 pixels per render)
-					rasterCoordinates[rasterCoordinateIndex++] = {k, thisHeight};
-				}
-				for (uint k = heights[lineNumV]; k < heights[lineNumV + 1]; k++) {
-					rasterCoordinates[rasterCoordinateIndex++] = {thisWidth, k};
-				}
-			}
-		}
-		for (uint lineNumH = 0; lineNumH < tiles; lineNumH++) {
-			for (uint k = widths[lineNumH]; k < widths[lineNumH + 1]; k++) {
-				rasterCoordinates[rasterCoordinateIndex++] = {k, ymax};
+			A horizontal line from widths[lineNumH] to widths[lineNumH + 1] includes the left corner point. A vertical line excludes both corner points because they already belong to a horizontal line, except the vertical lines at xmax, which include their top corner. The point (xmax, ymax) is calculated separately.
+		*/
+		struct RasterLine {
+			bool horizontal;
+			uint from, to; //including from; not including to
+			uint position;
+			uint lineNumH, lineNumV;
+		};
+		vector<RasterLine> rasterLines;
+		for (uint lineNumV = 0; lineNumV <= tiles; lineNumV++) {
+			for (uint lineNumH = 0; lineNumH < tiles; lineNumH++) {
+				rasterLines.push_back({true, widths[lineNumH], widths[lineNumH + 1], heights[lineNumV], lineNumH, lineNumV});
 			}
 		}
-		for (uint lineNumV = 0; lineNumV < tiles; lineNumV++) {
-			for (uint k = heights[lineNumV]; k < heights[lineNumV + 1]; k++) {
-				rasterCoordinates[rasterCoordinateIndex++] = {xmax, k};
+		for (uint lineNumH = 0; lineNumH <= tiles; lineNumH++) {
+			for (uint lineNumV = 0; lineNumV < tiles; lineNumV++) {
+				uint from = heights[lineNumV] + (lineNumH == tiles ? 0 : 1);
+				rasterLines.push_back({false, from, heights[lineNumV + 1], widths[lineNumH], lineNumH, lineNumV});
 			}
 		}
-		rasterCoordinates[rasterCoordinateIndex++] = {xmax, ymax};
-
+		vector<uint8> rasterLineSame(rasterLines.size()); //not vector<bool> because different threads write to it
 
-		//Calculate the array of raster pixels multithreaded:
+		//Calculate the raster multithreaded:
+		auto rasterStart = chrono::high_resolution_clock::now();
 		uint usingThreadCount = tiles * tiles;
-		uint pixelCount = rasterCoordinateIndex;
-		uint thrVectPieceSize = pixelCount / usingThreadCount;
-		uint createdRasterThreads = 0;
-		vector<thread> threadsRaster(usingThreadCount);
-
-		for (uint k = 0; k < usingThreadCount - 1; k++) {
-			threadsRaster[createdRasterThreads++] = thread(&Render::calcPointVector, this, ref(rasterCoordinates), k * thrVectPieceSize, (k + 1)*thrVectPieceSize);
+		atomic<uint> nextRasterLine{ 0 };
+		auto calcRasterLines = [&](uint worker) {
+			useCounterSlot(1 + worker);
+			for (uint k = nextRasterLine++; k < rasterLines.size(); k = nextRasterLine++) {
+				const RasterLine& l = rasterLines[k];
+				bool same = true;
+				if (l.to > l.from) {
+					if (l.horizontal)	same = calcHorizontalLine(l.from, l.to, l.position);
+					else				same = calcVerticalLine(l.from, l.to, l.position);
+				}
+				rasterLineSame[k] = same;
+			}
+		};
+		vector<thread> threadsRaster;
+		for (uint k = 0; k < usingThreadCount; k++) {
+			threadsRaster.emplace_back(calcRasterLines, k);
 		}
-		threadsRaster[createdRasterThreads++] = thread(&Render::calcPointVector, this, ref(rasterCoordinates), (usingThreadCount - 1) * thrVectPieceSize, pixelCount);
 
-		cout << "Calculating initial raster with " << createdRasterThreads << " threads" << endl;
-		for (uint k = 0; k < createdRasterThreads; k++)
-			threadsRaster[k].join();
+		cout << "Calculating initial raster with " << threadsRaster.size() << " threads" << endl;
+		for (thread& t : threadsRaster)
+			t.join();
 
+		uint64 iterations = 0;
+		calcPoint(xmax, ymax, iterations);
+		WorkerCounters::add(counters->iterations, iterations);
+		WorkerCounters::add(counters->calculated, 1);
 
 		//Check which rectangles in the raster can be guessed:
-		for (uint lineNumH = 0; lineNumH < tiles; lineNumH++) {
-			for (uint lineNumV = 0; lineNumV < tiles; lineNumV++) {
-				isSameList[(lineNumH * tiles + lineNumV) * 2] = isSameHorizontalLine(widths[lineNumH], widths[lineNumH + 1], heights[lineNumV]);
-				isSameList[(lineNumH * tiles + lineNumV) * 2 + 1] = isSameVerticalLine(heights[lineNumV], heights[lineNumV + 1], widths[lineNumH]);
+		for (uint k = 0; k < rasterLines.size(); k++) {
+			const RasterLine& l = rasterLines[k];
+			bool same = rasterLineSame[k];
+			if (l.horizontal) {
+				isSameList[(l.lineNumH * tiles + l.lineNumV) * 2] = same;
+			}
+			else {
+				//The same as isSameVerticalLine(heights[lineNumV], heights[lineNumV + 1], widths[lineNumH]): the line should be compared with the top corner point too.
+				if (l.to > l.from && l.from != heights[l.lineNumV])
+					same = same && canvas.getIterationcount(l.position, l.from) == canvas.getIterationcount(l.position, heights[l.lineNumV]);
+				isSameList[(l.lineNumH * tiles + l.lineNumV) * 2 + 1] = same;
 			}
 		}
-		for (uint lineNumH = 0; lineNumH < tiles; lineNumH++) {
-			isSameList[(lineNumH * tiles + tiles) * 2] = isSameHorizontalLine(widths[lineNumH], widths[lineNumH + 1], ymax);
-		}
-		for (uint lineNumV = 0; lineNumV < tiles; lineNumV++) {
-			isSameList[(tiles * tiles + lineNumV) * 2 + 1] = isSameVerticalLine(heights[lineNumV], heights[lineNumV + 1], xmax);
-		}
+
+		rasterSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - rasterStart).count();
 
 		//define work for worker threads
 		for (uint lineNumH = 0; lineNumH < tiles; lineNumH++) {
@@ -1276,22 +1365,187 @@ public:
 		}
 
 		//start worker threads:
+		auto tilesStart = chrono::high_resolution_clock::now();
 		vector<thread> threadsTiles(canvas.number_of_threads);
+		workers.assign(canvas.number_of_threads, {});
 		created_threads = 0;
 		for (int k=0; k<canvas.number_of_threads; k++) {
-			threadsTiles[created_threads++] = thread(&Render::renderSilverWorkLoop, this);
+			threadsTiles[created_threads] = thread(&Render::renderSilverWorkLoop, this, created_threads);
+			created_threads++;
 		}
 		cout << "Calculating tiles with " << created_threads << " threads" << endl;
 
 		for (int k = 0; k < created_threads; k++) {
 			threadsTiles[k].join();
 		}
+		tileSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - tilesStart).count();
 		cout << "Calculating tiles finished." << endl;
 		return;
 	}
 
 	
 
+	/*
+		Boundary tracing follows the edges of regions of points with the same iterationcount. Only the points at the edges are calculated. Everything inside is then filled with the iterationcount of the edge. Unlike the Mariani-Silver algorithm it doesn't need whole rectangles with the same iterationcount, so it can also guess in areas with a lot of thin filaments.
+
+		The canvas is divided into horizontal strips that are calculated independently by different threads. Every strip starts with the points on its boundary. For every point in the queue, the neighbors are calculated and compared to the point. If a neighbor has a different iterationcount, the point lies on the edge of a region, and the neighbors are added to the queue. The queue is processed in waves, so that all the points of a wave can be calculated together by calcPointVector (with AVX if available).
+
+		The strips are whole pixels high, so that every strip owns its pixels and can set the colors when it's done (see renderSilverRect).
+	*/
+	static constexpr uint8 TRACE_CALCULATED = 1;
+	static constexpr uint8 TRACE_QUEUED = 2;
+
+	struct BoundaryTracingScratch {
+		vector<uint8> state; //TRACE_CALCULATED and TRACE_QUEUED for every point in the strip
+		vector<point> wave;
+		vector<point> next_wave;
+		vector<point> to_calculate;
+	};
+
+	void renderBoundaryTracingStrip(uint ymin, uint ymax, BoundaryTracingScratch& scratch)
+	{
+		assert(ymax > ymin);
+		vector<uint8>& state = scratch.state;
+		vector<point>& wave = scratch.wave;
+		vector<point>& next_wave = scratch.next_wave;
+		vector<point>& to_calculate = scratch.to_calculate;
+
+		state.assign((size_t)width * (ymax - ymin), 0);
+		wave.clear();
+
+		auto stateOf = [&](uint x, uint y) -> uint8& {
+			return state[(size_t)(y - ymin) * width + x];
+		};
+		auto enqueue = [&](vector<point>& queue, uint x, uint y) {
+			uint8& s = stateOf(x, y);
+			if ( ! (s & TRACE_QUEUED)) {
+				s |= TRACE_QUEUED;
+				queue.push_back({x, y});
+			}
+		};
+		auto needCalculation = [&](uint x, uint y) {
+			uint8& s = stateOf(x, y);
+			if ( ! (s & TRACE_CALCULATED)) {
+				s |= TRACE_CALCULATED;
+				to_calculate.push_back({x, y});
+			}
+		};
+
+		//the boundary of the strip
+		for (uint x = 0; x < width; x++) {
+			enqueue(wave, x, ymin);
+			enqueue(wave, x, ymax - 1);
+		}
+		for (uint y = ymin; y < ymax; y++) {
+			enqueue(wave, 0, y);
+			enqueue(wave, width - 1, y);
+		}
+
+		while ( ! wave.empty()) {
+			if (renderID != canvas.lastRenderID)
+				return;
+
+			//calculate the points in the wave and their neighbors
+			to_calculate.clear();
+			for (point p : wave) {
+				needCalculation(p.x, p.y);
+				if (p.x > 0)			needCalculation(p.x - 1, p.y);
+				if (p.x < width - 1)	needCalculation(p.x + 1, p.y);
+				if (p.y > ymin)			needCalculation(p.x, p.y - 1);
+				if (p.y < ymax - 1)		needCalculation(p.x, p.y + 1);
+			}
+			calcPointVector(PointList{to_calculate.data()}, 0, to_calculate.size());
+
+			//queue the neighbors of points on an edge
+			next_wave.clear();
+			for (point p : wave) {
+				uint x = p.x;
+				uint y = p.y;
+				uint center = canvas.getIterationcount(x, y);
+				bool ll = x > 0;
+				bool rr = x < width - 1;
+				bool uu = y > ymin;
+				bool dd = y < ymax - 1;
+				bool l = ll && canvas.getIterationcount(x - 1, y) != center;
+				bool r = rr && canvas.getIterationcount(x + 1, y) != center;
+				bool u = uu && canvas.getIterationcount(x, y - 1) != center;
+				bool d = dd && canvas.getIterationcount(x, y + 1) != center;
+				if (l) enqueue(next_wave, x - 1, y);
+				if (r) enqueue(next_wave, x + 1, y);
+				if (u) enqueue(next_wave, x, y - 1);
+				if (d) enqueue(next_wave, x, y + 1);
+				//The diagonal neighbors are needed to not leak through corners of an edge.
+				if (uu && ll && (u || l)) enqueue(next_wave, x - 1, y - 1);
+				if (uu && rr && (u || r)) enqueue(next_wave, x + 1, y - 1);
+				if (dd && ll && (d || l)) enqueue(next_wave, x - 1, y + 1);
+				if (dd && rr && (d || r)) enqueue(next_wave, x + 1, y + 1);
+			}
+			swap(wave, next_wave);
+		}
+
+		//Fill the rest. Every point that hasn't been calculated is inside a region that is enclosed by calculated points with the same iterationcount, so the point to the left has the right value. Iterationcounts 0 and 1 are not guessed, like in renderSilverRect.
+		to_calculate.clear();
+		uint64 guessed = 0;
+		for (uint y = ymin; y < ymax; y++) {
+			IterData left = canvas.getIterData(0, y);
+			for (uint x = 1; x < width; x++) {
+				if (stateOf(x, y) & TRACE_CALCULATED) {
+					left = canvas.getIterData(x, y);
+				}
+				else if (left.iterationCount <= 1) {
+					to_calculate.push_back({x, y});
+				}
+				else {
+					canvas.setPixel(x, y, left.iterationCount, GUESSED, left.inMinibrot);
+					guessed++;
+				}
+			}
+		}
+		calcPointVector(PointList{to_calculate.data()}, 0, to_calculate.size());
+		WorkerCounters::add(counters->guessed, guessed);
+
+		if (renderID == canvas.lastRenderID)
+			renderBitmapRect(0, width / oversampling, ymin / oversampling, ymax / oversampling);
+	}
+
+	void renderBoundaryTracingFull()
+	{
+		assert(width > 0);
+		assert(height > 0);
+
+		uint strip_height = max(oversampling, (BOUNDARY_TRACING_STRIP_HEIGHT / oversampling) * oversampling); //whole pixels
+		uint strips = (height + strip_height - 1) / strip_height;
+
+		atomic<uint> nextStrip{ 0 };
+		auto work = [&](uint worker) {
+			useCounterSlot(1 + worker);
+			auto start = chrono::high_resolution_clock::now();
+			BoundaryTracingScratch scratch; //reused for all strips of this thread
+			for (uint k = nextStrip++; k < strips; k = nextStrip++) {
+				uint ymin = k * strip_height;
+				uint ymax = min(height, ymin + strip_height);
+				renderBoundaryTracingStrip(ymin, ymax, scratch);
+			}
+			workers[worker].busy_seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+		};
+
+		auto tilesStart = chrono::high_resolution_clock::now();
+		uint thread_count = min(canvas.number_of_threads, strips);
+		workers.assign(thread_count, {});
+		vector<thread> threads;
+		for (uint k = 0; k < thread_count; k++) {
+			threads.emplace_back(work, k);
+		}
+		cout << "Calculating " << strips << " strips with " << threads.size() << " threads" << endl;
+		for (thread& t : threads)
+			t.join();
+		tileSeconds = chrono::duration<double>(chrono::high_resolution_clock::now() - tilesStart).count();
+		//The strips are taken without waiting, so a thread is only idle after the last strip.
+		for (WorkerStatistics& worker : workers)
+			worker.idle_seconds = max(0.0, tileSeconds - worker.busy_seconds);
+		cout << "Calculating strips finished." << endl;
+	}
+
 	void spiral_test()
 	{
 		spiraler s(width-1,height-1);
@@ -1327,25 +1581,45 @@ public:
 		if (renderID != canvas.lastRenderID)
 			return;
 
+		useCounterSlot(0);
 		startTime = chrono::high_resolution_clock::now();
 		if constexpr(procedure_identifier == DEBUG_TEST.id) {
 			spiral_test();
 		}
+		else if (algorithm == RenderAlgorithm::BoundaryTracing && boundary_traceable) {
+			renderBoundaryTracingFull();
+		}
 		else {
 			renderSilverFull();
 		}
 		endTime = chrono::high_resolution_clock::now();
+
+		//All threads have been joined, so the counters are final.
+		ProgressInfo totals = sumCounters();
+		computedIterations = totals.computedIterations;
+		guessedPixelCount = totals.guessedPixelCount;
+		calculatedPixelCount = totals.calculatedPixelCount;
+		for (const WorkerCounters& c : counterSlots)
+			pixelGroupings += c.pixelGroupings.load(memory_order_relaxed);
 		ended = true;
+	}
 
-		for (uint i = 0; i < width; i++) {
-			for (uint j = 0; j < height; j++) {
-				computedIterations += canvas.iters[i*height + j].iterationCount;
-			}
+	//This can be used during the render. The totals may then be a little behind.
+	ProgressInfo sumCounters() {
+		ProgressInfo totals{ 0, 0, 0, 0, false };
+		for (const WorkerCounters& c : counterSlots) {
+			totals.guessedPixelCount += c.guessed.load(memory_order_relaxed);
+			totals.calculatedPixelCount += c.calculated.load(memory_order_relaxed);
+			totals.computedIterations += c.iterations.load(memory_order_relaxed);
 		}
+		return totals;
 	}
 	
 	ProgressInfo getProgress() {
-		return { guessedPixelCount, calculatedPixelCount, getElapsedTime(), ended };
+		ProgressInfo progress = sumCounters();
+		progress.elapsedTime = getElapsedTime();
+		progress.ended = ended;
+		return progress;
 	}
 
 	void* canvasPtr() {
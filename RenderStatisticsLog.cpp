@@ -0,0 +1,94 @@
+/*
+    ExploreFractals, a tool for testing the effect of Mandelbrot set Julia morphings
+    Copyright (C) 2021  DinkydauSet
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef RENDERSTATISTICSLOG_H
+#define RENDERSTATISTICSLOG_H
+
+//standard library
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <mutex>
+
+//this program
+#include "common.cpp"
+
+string stats_json_file = ""; //the file for --stats-json. Empty means that no statistics are written, "-" means stderr.
+mutex statsJsonMutex;
+
+/*
+	Writes the statistics of a render as a line with a JSON object to stats_json_file (JSON lines), for example:
+		{"time":1634567890,"render":3,"canvas":"0x55d4c2a0","procedure":"Mandelbrot power 2","algorithm":"Mariani-Silver","avx":true,"julia":false,"width":1200,"height":800,"threads":12,"cancelled":false,"cancel_latency":null,"seconds":0.52,"raster_seconds":0.004,"tile_seconds":0.51,"bitmap_seconds":0.09,"computed_iterations":123456789,"guessed_points":700000,"calculated_points":260000,"points":960000,"tiles_split":1500,"tiles_filled":700,"tiles_calculated":800,"queue_waits":40,"queue_wait_seconds":0.03,"buffer_bytes":8388608,"peak_buffer_bytes":8388608,"workers":[{"busy":0.5,"idle":0.002},...]}
+	time is in seconds since 1970. cancel_latency is the time in seconds between the cancellation of the render and the moment that it stopped, or null if it was not cancelled or the time of the cancellation is not known. queue_wait_seconds is the time that the tiles spent in the work queue before a thread took them. canvas tells apart the renders of different tabs.
+
+	Renders in the GUI and on the command line are both written. This can be used from several threads.
+*/
+void logRenderStatistics(const RenderStatistics& s, int renderID, const void* canvas, string procedure, string algorithm, bool avx, bool julia, uint width, uint height)
+{
+	std::ostringstream line;
+	line << "{\"time\":" << (int64)time(nullptr)
+		<< ",\"render\":" << renderID
+		<< ",\"canvas\":\"" << canvas << "\""
+		<< ",\"procedure\":\"" << procedure << "\""
+		<< ",\"algorithm\":\"" << algorithm << "\""
+		<< ",\"avx\":" << (avx ? "true" : "false")
+		<< ",\"julia\":" << (julia ? "true" : "false")
+		<< ",\"width\":" << width
+		<< ",\"height\":" << height
+		<< ",\"threads\":" << s.threads
+		<< ",\"cancelled\":" << (s.cancelled ? "true" : "false")
+		<< ",\"cancel_latency\":";
+	if (s.cancelled && s.cancel_latency >= 0)
+		line << s.cancel_latency;
+	else
+		line << "null";
+	line << ",\"seconds\":" << s.seconds
+		<< ",\"raster_seconds\":" << s.raster_seconds
+		<< ",\"tile_seconds\":" << s.tile_seconds
+		<< ",\"bitmap_seconds\":" << s.bitmap_seconds
+		<< ",\"computed_iterations\":" << s.computed_iterations
+		<< ",\"guessed_points\":" << s.guessed_points
+		<< ",\"calculated_points\":" << s.calculated_points
+		<< ",\"points\":" << s.points
+		<< ",\"tiles_split\":" << s.tiles_split
+		<< ",\"tiles_filled\":" << s.tiles_filled
+		<< ",\"tiles_calculated\":" << s.tiles_calculated
+		<< ",\"queue_waits\":" << s.queue_waits
+		<< ",\"queue_wait_seconds\":" << s.queue_wait_seconds
+		<< ",\"buffer_bytes\":" << s.buffer_bytes
+		<< ",\"peak_buffer_bytes\":" << s.peak_buffer_bytes
+		<< ",\"workers\":[";
+	for (size_t i=0; i<s.workers.size(); i++) {
+		line << (i > 0 ? "," : "") << "{\"busy\":" << s.workers[i].busy_seconds << ",\"idle\":" << s.workers[i].idle_seconds << "}";
+	}
+	line << "]}\n";
+	string text = line.str();
+
+	lock_guard<mutex> guard(statsJsonMutex);
+	if (stats_json_file == "-") {
+		fwrite(text.data(), 1, text.size(), stderr);
+		fflush(stderr);
+		return;
+	}
+	if ( ! appendLine(stats_json_file, text))
+		cout << "error while writing to the statistics file " << stats_json_file << endl;
+}
+
+
+#endif
@@ -0,0 +1,911 @@
+/*
+    ExploreFractals, a tool for testing the effect of Mandelbrot set Julia morphings
+    Copyright (C) 2021  DinkydauSet
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMINGIMAGE_H
+#define STREAMINGIMAGE_H
+
+//standard library
+#include <fstream>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+//lodepng (which has no include guard, so it can be included only here)
+#include "lodepng/lodepng.cpp"
+
+//this program
+#include "common.cpp"
+#include "FractalParameters.cpp"
+#include "FractalCanvas.cpp"
+#include "utilities.cpp"
+
+//The adler32 checksum of two pieces of data after each other, from the checksums of the pieces. This is how zlib's adler32_combine does it.
+inline uint adler32_combine(uint adler1, uint adler2, size_t length2)
+{
+	constexpr uint BASE = 65521;
+	uint rem = (uint)(length2 % BASE);
+	uint sum1 = adler1 & 0xFFFF;
+	uint sum2 = (rem * sum1) % BASE;
+	sum1 += (adler2 & 0xFFFF) + BASE - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + BASE - rem;
+	if (sum1 >= BASE) sum1 -= BASE;
+	if (sum1 >= BASE) sum1 -= BASE;
+	if (sum2 >= (BASE << 1)) sum2 -= (BASE << 1);
+	if (sum2 >= BASE) sum2 -= BASE;
+	return sum1 | (sum2 << 16);
+}
+
+//The CRC32 of data after the data that has checksum crc (0 for no data before), with lodepng's table. This is the same CRC32 as zlib's.
+inline uint update_crc32(uint crc, const uint8* data, size_t length)
+{
+	crc = ~crc;
+	for (size_t i=0; i<length; i++)
+		crc = lodepng_crc32_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+struct CompressedRows {
+	vector<uint8> data; //deflate blocks, ending on a whole byte
+	uint adler{ 1 }; //the adler32 checksum of the filtered rows
+	size_t filtered_size{ 0 }; //the size of the filtered rows
+	bool success{ true };
+};
+
+/*
+	Filters and compresses row_count rows of an image with the given color type with parts of lodepng. If has_previous_row, rows starts with the row above the first row, which is needed for filtering but isn't compressed again.
+
+	The result can be put after the compressed rows above it in the same zlib stream. It doesn't refer to data from before, and it ends with an empty uncompressed deflate block, like zlib does for Z_SYNC_FLUSH, which makes it end on a whole byte. That makes it possible to compress parts of an image at the same time.
+*/
+CompressedRows compressPNGRows(const uint8* rows, uint row_count, bool has_previous_row, uint width, const LodePNGColorMode& color)
+{
+	CompressedRows result;
+	const size_t linebytes = ((size_t)width * lodepng_get_bpp(&color) + 7) / 8;
+	const uint total_rows = row_count + (has_previous_row ? 1 : 0);
+
+	LodePNGEncoderSettings settings;
+	lodepng_encoder_settings_init(&settings);
+
+	//lodepng's filter function treats the first row as the first row of the image. If there's a row before, it's included so that the filters of the rows are based on it, and then its filtered version is skipped.
+	vector<uint8> filtered(total_rows * (linebytes + 1));
+	if (filter(filtered.data(), rows, width, total_rows, &color, &settings) != 0) {
+		result.success = false;
+		return result;
+	}
+	const uint8* data = filtered.data() + (has_previous_row ? linebytes + 1 : 0);
+	size_t size = row_count * (linebytes + 1);
+	result.adler = update_adler32(1, data, (uint)size);
+	result.filtered_size = size;
+
+	ucvector out = ucvector_init(nullptr, 0);
+	LodePNGBitWriter writer;
+	LodePNGBitWriter_init(&writer, &out);
+
+	//the same block size as lodepng uses
+	const size_t blocksize = 262144;
+	Hash hash;
+	if (hash_init(&hash, settings.zlibsettings.windowsize) != 0)
+		result.success = false;
+	else {
+		for (size_t start = 0; start < size && result.success; start += blocksize) {
+			if (deflateDynamic(&writer, &hash, data, start, min(size, start + blocksize), &settings.zlibsettings, 0) != 0)
+				result.success = false;
+		}
+	}
+	hash_cleanup(&hash);
+
+	//an empty uncompressed block that isn't the last one: BFINAL 0, BTYPE 00, padding to a whole byte, LEN 0 and NLEN 0xFFFF
+	writeBits(&writer, 0, 1);
+	writeBits(&writer, 0, 2);
+	result.data.assign(out.data, out.data + out.size);
+	result.data.insert(result.data.end(), { 0x00, 0x00, 0xFF, 0xFF });
+	lodepng_free(out.data);
+	return result;
+}
+
+/*
+	Threads that compress the blocks of PNG files (see PNGStreamWriter). They're started once and used for every part of an image that's compressed, and ImageSaveQueue uses the same threads for all images.
+*/
+class PNGCompressionThreads {
+	vector<thread> threads; //the calling thread of run is the other one
+	mutex m;
+	condition_variable changed;
+	std::function<void()> job;
+	uint64 round{ 0 }; //the number of jobs so far
+	uint busy{ 0 }; //the number of threads that haven't finished the job yet
+	bool stop{ false };
+
+	void work()
+	{
+		uint64 done = 0;
+		while (true)
+		{
+			std::function<void()> current;
+			{
+				unique_lock<mutex> lock(m);
+				changed.wait(lock, [&]{ return stop || round != done; });
+				if (stop)
+					return;
+				done = round;
+				current = job;
+			}
+			current();
+			{
+				lock_guard<mutex> guard(m);
+				busy--;
+			}
+			changed.notify_all();
+		}
+	}
+
+public:
+	PNGCompressionThreads(uint number_of_threads)
+	{
+		for (uint i=1; i<number_of_threads; i++)
+			threads.push_back(thread(&PNGCompressionThreads::work, this));
+	}
+
+	~PNGCompressionThreads()
+	{
+		{
+			lock_guard<mutex> guard(m);
+			stop = true;
+		}
+		changed.notify_all();
+		for (thread& t : threads)
+			t.join();
+	}
+
+	uint count() {
+		return (uint)threads.size() + 1;
+	}
+
+	//Calls job in every thread, including this one, and returns when they're all done. The job divides the work over the threads itself.
+	void run(std::function<void()> job)
+	{
+		{
+			lock_guard<mutex> guard(m);
+			this->job = job;
+			round++;
+			busy = (uint)threads.size();
+		}
+		changed.notify_all();
+		job();
+		unique_lock<mutex> lock(m);
+		changed.wait(lock, [&]{ return busy == 0; });
+	}
+};
+
+/*
+	Writes a PNG file row by row, so that the whole image never has to be in memory, not even compressed.
+
+	lodepng encodes whole images at once. This uses parts of lodepng instead: the rows are collected until there are enough of them, and then filtered and compressed and written as an IDAT chunk. That's possible because the compressed data of a PNG is one zlib stream that can be split over any number of IDAT chunks. The collected rows are divided into blocks that the compression threads compress at the same time (see compressPNGRows).
+
+	The image is saved with the color type color, which is RGB without alpha (the alpha is always 255) by default. lodepng chooses a palette for images with few colors, which needs all colors of the image before the first row. savePixels does that for images that are in memory.
+*/
+class PNGStreamWriter {
+	static constexpr size_t PENDING_BYTES = 1 << 24; //the amount of uncompressed data that's collected before compressing it
+	static constexpr size_t BLOCK_BYTES = 1 << 20; //the amount of uncompressed data that one thread compresses at a time
+
+	ofstream file;
+	string filename;
+	uint width;
+	uint height;
+	PNGCompressionThreads& compression_threads;
+	LodePNGColorMode rgb; //the colors of the rows that are added
+	LodePNGColorMode color; //the colors of the file
+	vector<uint8> rgb_row; //a row converted to rgb, if color is something else
+	size_t linebytes; //in the file
+	uint rows_written{ 0 }; //the number of rows that have been added with addRow
+	uint adler{ 1 }; //the adler32 checksum of all uncompressed data so far, which ends the zlib stream
+	bool stream_started{ false }; //whether the zlib header has been written
+	bool error{ false };
+	bool finished{ false };
+	uint file_checksum{ 0 }; //the CRC32 of everything written to the file
+
+	//Rows that have been added but not compressed yet, as RGB. If there have been rows before, the first row here is the last row of those. It's needed for filtering.
+	vector<uint8> pending;
+	uint pending_rows{ 0 };
+	bool has_previous_row{ false };
+
+	void writeBytes(const uint8* data, size_t size)
+	{
+		file.write((const char*)data, size);
+		file_checksum = update_crc32(file_checksum, data, size);
+	}
+
+	void writeChunk(const char* type, const uint8* data, size_t size)
+	{
+		uint8* chunk = nullptr;
+		size_t chunksize = 0;
+		if (lodepng_chunk_create(&chunk, &chunksize, (uint)size, type, data) != 0) {
+			cout << "error while creating PNG chunk " << type << endl;
+			error = true;
+		}
+		else {
+			writeBytes(chunk, chunksize);
+			if ( ! file.good()) {
+				cout << "error while writing to file " << filename << endl;
+				error = true;
+			}
+		}
+		free(chunk);
+	}
+
+	//Filters and compresses the pending rows and writes them as an IDAT chunk. final ends the zlib stream.
+	void compressPending(bool final)
+	{
+		vector<uint8> out;
+
+		if ( ! stream_started) {
+			//These are the same zlib header bytes as lodepng uses.
+			out.insert(out.end(), { 0x78, 0x01 });
+			stream_started = true;
+		}
+
+		uint new_rows = pending_rows - (has_previous_row ? 1 : 0);
+		if (new_rows > 0) {
+			uint block_rows = (uint)max<size_t>(1, BLOCK_BYTES / linebytes);
+			uint blocks = (new_rows + block_rows - 1) / block_rows;
+			vector<CompressedRows> results(blocks);
+			atomic<uint> next_block{ 0 };
+
+			auto compressBlocks = [&]() {
+				for (uint i = next_block++; i < blocks; i = next_block++) {
+					uint first = (has_previous_row ? 1 : 0) + i * block_rows; //the first row of the block in pending
+					uint rows = min(block_rows, pending_rows - first);
+					bool previous = first > 0;
+					results[i] = compressPNGRows(pending.data() + (first - (previous ? 1 : 0)) * linebytes, rows, previous, width, color);
+				}
+			};
+			if (blocks > 1 && compression_threads.count() > 1)
+				compression_threads.run(compressBlocks);
+			else
+				compressBlocks();
+
+			for (const CompressedRows& r : results) {
+				if ( ! r.success)
+					error = true;
+				out.insert(out.end(), r.data.begin(), r.data.end());
+				adler = adler32_combine(adler, r.adler, r.filtered_size);
+			}
+		}
+
+		if (final) {
+			//an empty uncompressed block that ends the deflate stream: BFINAL 1, BTYPE 00, padding to a whole byte, LEN 0 and NLEN 0xFFFF
+			out.insert(out.end(), { 0x01, 0x00, 0x00, 0xFF, 0xFF });
+			out.insert(out.end(), { (uint8)(adler >> 24), (uint8)(adler >> 16), (uint8)(adler >> 8), (uint8)adler });
+		}
+
+		if ( ! error && out.size() > 0)
+			writeChunk("IDAT", out.data(), out.size());
+
+		//keep the last row
+		if (pending_rows > 0) {
+			copy(pending.end() - linebytes, pending.end(), pending.begin());
+			pending.resize(linebytes);
+			pending_rows = 1;
+			has_previous_row = true;
+		}
+	}
+
+public:
+	//If color is nullptr, the file is RGB.
+	PNGStreamWriter(string filename, uint width, uint height, PNGCompressionThreads& compression_threads, const LodePNGColorMode* color = nullptr)
+	: filename(filename)
+	, width(width)
+	, height(height)
+	, compression_threads(compression_threads)
+	{
+		rgb = lodepng_color_mode_make(LCT_RGB, 8);
+		lodepng_color_mode_init(&this->color);
+		if (color == nullptr)
+			this->color = rgb;
+		else if (lodepng_color_mode_copy(&this->color, color) != 0) {
+			cout << "error while copying the PNG colors" << endl;
+			error = true;
+			return;
+		}
+		linebytes = ((size_t)width * lodepng_get_bpp(&this->color) + 7) / 8;
+		if ( ! lodepng_color_mode_equal(&this->color, &rgb))
+			rgb_row.resize((size_t)width * 3);
+
+		file.open(filename, ios::binary);
+		if ( ! file.is_open()) {
+			cout << "error while opening file " << filename << endl;
+			error = true;
+			return;
+		}
+
+		const uint8 signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+		writeBytes(signature, 8);
+
+		uint8 header[13];
+		lodepng_set32bitInt(header, width);
+		lodepng_set32bitInt(header + 4, height);
+		header[8] = (uint8)this->color.bitdepth;
+		header[9] = (uint8)this->color.colortype;
+		header[10] = 0; //compression method
+		header[11] = 0; //filter method
+		header[12] = 0; //interlace method
+		writeChunk("IHDR", header, 13);
+
+		if (this->color.colortype == LCT_PALETTE) {
+			vector<uint8> palette(this->color.palettesize * 3);
+			for (size_t i=0; i<this->color.palettesize; i++)
+				copy(this->color.palette + 4 * i, this->color.palette + 4 * i + 3, palette.begin() + 3 * i); //without the alpha
+			writeChunk("PLTE", palette.data(), palette.size());
+		}
+	}
+
+	~PNGStreamWriter() {
+		lodepng_color_mode_cleanup(&color);
+	}
+
+	bool good() {
+		return ! error;
+	}
+
+	//the CRC32 of the whole file, after finish
+	uint checksum() {
+		return file_checksum;
+	}
+
+	//Adds the next row of the image. The row should contain width pixels.
+	void addRow(const ARGB* row)
+	{
+		assert(rows_written < height);
+		if (error)
+			return;
+
+		size_t oldsize = pending.size();
+		pending.resize(oldsize + linebytes);
+		uint8* out = pending.data() + oldsize;
+		uint8* rgb_out = rgb_row.empty() ? out : rgb_row.data();
+		for (uint x=0; x<width; x++) {
+			rgb_out[3*x]     = row[x].R;
+			rgb_out[3*x + 1] = row[x].G;
+			rgb_out[3*x + 2] = row[x].B;
+		}
+		if ( ! rgb_row.empty() && lodepng_convert(out, rgb_out, &color, &rgb, width, 1) != 0) {
+			cout << "error while converting the colors of a row of " << filename << endl;
+			error = true;
+			return;
+		}
+		pending_rows++;
+		rows_written++;
+
+		if (pending.size() >= PENDING_BYTES)
+			compressPending(false);
+	}
+
+	//Writes the rest of the file. Returns whether the whole file was written successfully.
+	bool finish()
+	{
+		assert( ! finished);
+		finished = true;
+		if (rows_written != height) {
+			cout << "PNG " << filename << " is incomplete: " << rows_written << " of " << height << " rows" << endl;
+			error = true;
+		}
+		if ( ! error)
+			compressPending(true);
+		if ( ! error)
+			writeChunk("IEND", nullptr, 0);
+		file.close();
+		return ! error;
+	}
+};
+
+/*
+	Renders the image described by P in horizontal bands of band_height rows of pixels and writes it to a PNG file while rendering. Only one band is in memory at a time, so this can render images that are much larger than the available memory, and larger than MAXIMUM_BITMAP_SIZE.
+
+	Each band is a separate render, so Mariani-Silver stays within the band. Because of that, the result can be a little different from rendering the whole image at once.
+
+	A render needs at least 3 rows of points, so a band needs at least that many rows of pixels times the oversampling. If the last band would be shorter, it starts earlier and the rows that are already written are rendered again.
+*/
+bool renderImageInBands(const FractalParameters& P, uint band_height, RenderAlgorithm algorithm, uint number_of_threads, string filename)
+{
+	assert(band_height > 0);
+	uint width = P.width_resolution();
+	uint height = P.height_resolution();
+	uint oversampling = P.get_oversampling();
+	uint minimum_rows = (3 + oversampling - 1) / oversampling;
+
+	if (band_height < minimum_rows) {
+		cout << "The band height has to be at least " << minimum_rows << " with oversampling " << oversampling << "." << endl;
+		return false;
+	}
+	if (height < minimum_rows) {
+		cout << "The image has to be at least " << minimum_rows << " rows high with oversampling " << oversampling << "." << endl;
+		return false;
+	}
+
+	PNGCompressionThreads compression_threads(number_of_threads);
+	PNGStreamWriter png(filename, width, height, compression_threads);
+	if ( ! png.good())
+		return false;
+
+	FractalCanvas canvas(number_of_threads, make_shared<SimpleBitmapManager>());
+	canvas.render_algorithm = algorithm;
+
+	for (uint first_row = 0; first_row < height; first_row += band_height)
+	{
+		uint rows = min(band_height, height - first_row);
+		uint band_start = rows < minimum_rows ? height - minimum_rows : first_row; //first_row minus the rows that are rendered again
+		uint band_rows = first_row + rows - band_start;
+		cout << "rendering rows " << first_row << " to " << first_row + rows << " of " << height << endl;
+
+		ResizeResult res = canvas.changeParameters([&](FractalParameters& bandP) {
+			bandP.fromParameters(P);
+			bandP.restrictToBand(band_start, band_rows);
+		});
+		if ( ! res.success) {
+			cout << "The band can't be rendered. Try a smaller band height." << endl;
+			png.finish();
+			return false;
+		}
+		canvas.lastRenderStatistics = RenderStatistics();
+		canvas.createNewRender();
+		const RenderStatistics& stats = canvas.lastRenderStatistics;
+		if (stats.calculated_points == 0 || stats.cancelled) {
+			cout << "The band of rows " << first_row << " to " << first_row + rows << " wasn't rendered." << endl;
+			png.finish();
+			return false;
+		}
+
+		for (uint y = first_row - band_start; y < band_rows && png.good(); y++) {
+			png.addRow(&canvas.ptPixels[canvas.pixelIndex_of_pixelXY(0, y)]);
+		}
+		if ( ! png.good())
+			break;
+	}
+	bool success = png.finish();
+	if (success)
+		cout << "saved image " << filename << endl;
+	return success;
+}
+
+/*
+	The color type that lodepng would choose for the image: a palette for images with at most 256 colors (with fewer bits per pixel for very few colors), grey for grey images and otherwise RGB. The alpha is always 255, so it's left out. The palette should be freed with lodepng_color_mode_cleanup.
+*/
+LodePNGColorMode smallestColorMode(const ARGB* pixels, uint width, uint height)
+{
+	LodePNGColorMode rgb = lodepng_color_mode_make(LCT_RGB, 8);
+	LodePNGColorStats stats;
+	lodepng_color_stats_init(&stats);
+	vector<uint8> row((size_t)width * 3);
+	for (uint y=0; y<height; y++)
+	{
+		const ARGB* in = pixels + (size_t)y * width;
+		for (uint x=0; x<width; x++) {
+			row[3*x]     = in[x].R;
+			row[3*x + 1] = in[x].G;
+			row[3*x + 2] = in[x].B;
+		}
+		if (lodepng_compute_color_stats(&stats, row.data(), width, 1, &rgb) != 0)
+			return rgb;
+		if (stats.colored && stats.numcolors > 256)
+			break; //it's going to be RGB, the other rows don't change that
+	}
+	LodePNGColorMode color;
+	lodepng_color_mode_init(&color);
+	if (auto_choose_color(&color, &rgb, &stats) != 0) {
+		lodepng_color_mode_cleanup(&color);
+		return rgb;
+	}
+	return color;
+}
+
+//Saves width * height pixels, row by row, as a PNG file with the smallest color type. If checksum isn't nullptr, it's set to the CRC32 of the file.
+bool savePixels(const ARGB* pixels, uint width, uint height, PNGCompressionThreads& compression_threads, string filename, uint* checksum = nullptr)
+{
+	LodePNGColorMode color = smallestColorMode(pixels, width, height);
+	bool success;
+	{
+		PNGStreamWriter png(filename, width, height, compression_threads, &color);
+		for (uint y=0; y<height && png.good(); y++) {
+			png.addRow(pixels + (size_t)y * width);
+		}
+		success = png.finish();
+		if (checksum != nullptr)
+			*checksum = png.checksum();
+	}
+	lodepng_color_mode_cleanup(&color);
+	return success;
+}
+
+/*
+	Saves the bitmap of the canvas as a PNG file. The colors are converted while the rows are added, so the bitmap doesn't change.
+*/
+bool saveImage(FractalCanvas* canvas, string filename)
+{
+	uint width = canvas->P().width_resolution();
+	uint height = canvas->P().height_resolution();
+	PNGCompressionThreads compression_threads(canvas->number_of_threads);
+	return savePixels(&canvas->ptPixels[canvas->pixelIndex_of_pixelXY(0, 0)], width, height, compression_threads, filename);
+}
+
+/*
+	Saves images as PNG files in the background. This is for animations: saveImage takes a while for large images and meanwhile the render threads would have nothing to do.
+
+	addImage copies the bitmap of the canvas and returns, so the canvas can render the next frame right away. A separate thread compresses and writes the copies in the order in which they were added. At most MAXIMUM_QUEUED_IMAGES images wait to be saved. When there are more, addImage waits until one is saved, so the memory use stays limited when saving is slower than rendering.
+*/
+class ImageSaveQueue {
+	static constexpr uint MAXIMUM_QUEUED_IMAGES = 2;
+
+	struct QueuedImage {
+		vector<ARGB> pixels;
+		uint width;
+		uint height;
+		string filename;
+		std::function<void(uint, double)> saved; //called with the CRC32 of the file and the time that saving took in seconds, after it's saved successfully
+	};
+
+	PNGCompressionThreads compression_threads;
+	atomic<bool> error{ false };
+	bool finished{ false };
+
+	mutex queueMutex;
+	condition_variable queueChanged;
+	deque<QueuedImage> queue; //images that have been added but not saved yet
+	vector<vector<ARGB>> spare; //memory of images that have been saved, to use again
+	bool no_more_images{ false };
+	thread saver;
+
+	void saveImages()
+	{
+		while (true)
+		{
+			QueuedImage image;
+			{
+				unique_lock<mutex> lock(queueMutex);
+				queueChanged.wait(lock, [&]{ return ! queue.empty() || no_more_images; });
+				if (queue.empty())
+					break;
+				image = move(queue.front());
+			}
+
+			auto start = chrono::high_resolution_clock::now();
+			uint checksum = 0;
+			if ( ! savePixels(image.pixels.data(), image.width, image.height, compression_threads, image.filename, &checksum)) {
+				cout << "error while saving image " << image.filename << endl;
+				error = true;
+			}
+			else if (image.saved) {
+				chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+				image.saved(checksum, elapsed.count());
+			}
+			{
+				//The image is removed from the queue only after it's saved, so that the queue limits the number of copies in memory.
+				lock_guard<mutex> guard(queueMutex);
+				queue.pop_front();
+				spare.push_back(move(image.pixels));
+			}
+			queueChanged.notify_all();
+		}
+	}
+
+public:
+	ImageSaveQueue(uint number_of_threads)
+	: compression_threads(max(1u, number_of_threads))
+	{
+		saver = thread(&ImageSaveQueue::saveImages, this);
+	}
+
+	~ImageSaveQueue() {
+		if ( ! finished)
+			finish();
+	}
+
+	void addImage(FractalCanvas& canvas, string filename)
+	{
+		addImage(&canvas.ptPixels[canvas.pixelIndex_of_pixelXY(0, 0)], canvas.P().width_resolution(), canvas.P().height_resolution(), filename);
+	}
+
+	//Adds width * height pixels, row by row. saved is called in the thread that saves the image, when it's saved successfully.
+	void addImage(const ARGB* pixels, uint width, uint height, string filename, std::function<void(uint, double)> saved = nullptr)
+	{
+		assert( ! finished);
+		if (finished)
+			return;
+
+		QueuedImage image;
+		image.width = width;
+		image.height = height;
+		image.filename = filename;
+		image.saved = saved;
+		{
+			unique_lock<mutex> lock(queueMutex);
+			queueChanged.wait(lock, [&]{ return queue.size() < MAXIMUM_QUEUED_IMAGES; });
+			if ( ! spare.empty()) {
+				image.pixels = move(spare.back());
+				spare.pop_back();
+			}
+		}
+		image.pixels.assign(pixels, pixels + (size_t)width * height);
+		{
+			lock_guard<mutex> guard(queueMutex);
+			queue.push_back(move(image));
+		}
+		queueChanged.notify_all();
+	}
+
+	//Saves the images that are still waiting. Returns whether all images were saved successfully.
+	bool finish()
+	{
+		if (finished)
+			return ! error;
+		finished = true;
+		{
+			lock_guard<mutex> guard(queueMutex);
+			no_more_images = true;
+		}
+		queueChanged.notify_all();
+		saver.join();
+		return ! error;
+	}
+};
+
+
+enum class FrameFormat {
+	PPM, //binary PPM (P6) images after each other, which is RGB
+	Y4M_420, //YUV4MPEG2 with 4:2:0 chroma subsampling, which most video encoders want
+	Y4M_444, //YUV4MPEG2 without chroma subsampling
+};
+
+//RGB to YUV (BT.601, limited range) with the usual integer approximation
+inline uint8 rgbToY(int r, int g, int b) { return (uint8)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16); }
+inline uint8 rgbToU(int r, int g, int b) { return (uint8)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128); }
+inline uint8 rgbToV(int r, int g, int b) { return (uint8)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128); }
+
+/*
+	Writes animation frames as uncompressed video to a file, a FIFO or stdout (filename "-"), for example to pipe them into a video encoder. That's much faster than saving every frame as a PNG file.
+
+	addFrame copies the frame and returns, and a separate thread converts and writes it. That way, writing a frame happens while the next frame is rendered. At most MAXIMUM_QUEUED_FRAMES frames wait to be written. When there are more, addFrame waits, which happens when the reader of the stream is slower than the render.
+*/
+class FrameStreamWriter {
+	static constexpr uint MAXIMUM_QUEUED_FRAMES = 2;
+
+	FILE* file{ nullptr };
+	bool close_file{ false };
+	string filename;
+	FrameFormat format;
+	uint width;
+	uint height;
+	atomic<bool> error{ false };
+	bool finished{ false };
+
+	mutex queueMutex;
+	condition_variable queueChanged;
+	struct QueuedFrame {
+		vector<ARGB> pixels;
+		std::function<void(double)> written; //called with the time that converting and writing took in seconds
+	};
+	deque<QueuedFrame> queue; //frames that have been added but not written yet
+	vector<vector<ARGB>> spare; //memory of frames that have been written, to use again
+	bool no_more_frames{ false };
+	thread writer;
+
+	void writeBytes(const void* data, size_t size)
+	{
+		if (fwrite(data, 1, size, file) != size) {
+			if ( ! error)
+				cout << "error while writing frames to " << filename << endl;
+			error = true;
+		}
+	}
+
+	void encodeFrame(const ARGB* pixels, vector<uint8>& out)
+	{
+		const size_t size = (size_t)width * height;
+		out.clear();
+
+		if (format == FrameFormat::PPM) {
+			string header = "P6\n" + to_string(width) + " " + to_string(height) + "\n255\n";
+			out.insert(out.end(), header.begin(), header.end());
+			size_t start = out.size();
+			out.resize(start + size * 3);
+			uint8* rgb = out.data() + start;
+			for (size_t i=0; i<size; i++) {
+				rgb[3*i]     = pixels[i].R;
+				rgb[3*i + 1] = pixels[i].G;
+				rgb[3*i + 2] = pixels[i].B;
+			}
+			return;
+		}
+
+		const string header = "FRAME\n";
+		out.insert(out.end(), header.begin(), header.end());
+		size_t start = out.size();
+		uint8* Y = nullptr;
+
+		if (format == FrameFormat::Y4M_444) {
+			out.resize(start + size * 3);
+			Y = out.data() + start;
+			uint8* U = Y + size;
+			uint8* V = U + size;
+			for (size_t i=0; i<size; i++) {
+				int r = pixels[i].R, g = pixels[i].G, b = pixels[i].B;
+				Y[i] = rgbToY(r, g, b);
+				U[i] = rgbToU(r, g, b);
+				V[i] = rgbToV(r, g, b);
+			}
+			return;
+		}
+
+		//4:2:0: one U and V for every 2x2 pixels, from their average color
+		const uint chroma_width = (width + 1) / 2;
+		const uint chroma_height = (height + 1) / 2;
+		const size_t chroma_size = (size_t)chroma_width * chroma_height;
+		out.resize(start + size + chroma_size * 2);
+		Y = out.data() + start;
+		uint8* U = Y + size;
+		uint8* V = U + chroma_size;
+		for (size_t i=0; i<size; i++) {
+			Y[i] = rgbToY(pixels[i].R, pixels[i].G, pixels[i].B);
+		}
+		for (uint cy=0; cy<chroma_height; cy++)
+		for (uint cx=0; cx<chroma_width; cx++) {
+			int r = 0, g = 0, b = 0, count = 0;
+			for (uint y = cy * 2; y < min(height, cy * 2 + 2); y++)
+			for (uint x = cx * 2; x < min(width, cx * 2 + 2); x++) {
+				const ARGB& c = pixels[(size_t)y * width + x];
+				r += c.R; g += c.G; b += c.B;
+				count++;
+			}
+			r = (r + count / 2) / count;
+			g = (g + count / 2) / count;
+			b = (b + count / 2) / count;
+			size_t ci = (size_t)cy * chroma_width + cx;
+			U[ci] = rgbToU(r, g, b);
+			V[ci] = rgbToV(r, g, b);
+		}
+	}
+
+	void writeFrames()
+	{
+		vector<uint8> encoded;
+		while (true)
+		{
+			QueuedFrame frame;
+			{
+				unique_lock<mutex> lock(queueMutex);
+				queueChanged.wait(lock, [&]{ return ! queue.empty() || no_more_frames; });
+				if (queue.empty())
+					break;
+				frame = move(queue.front());
+				queue.pop_front();
+			}
+			queueChanged.notify_all();
+
+			//After an error the frames are still taken from the queue, so that addFrame doesn't wait forever.
+			if ( ! error) {
+				auto start = chrono::high_resolution_clock::now();
+				encodeFrame(frame.pixels.data(), encoded);
+				writeBytes(encoded.data(), encoded.size());
+				chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - start;
+				if ( ! error && frame.written)
+					frame.written(elapsed.count());
+			}
+			{
+				lock_guard<mutex> guard(queueMutex);
+				spare.push_back(move(frame.pixels));
+			}
+		}
+		if (fflush(file) != 0)
+			error = true;
+	}
+
+public:
+	FrameStreamWriter(string filename, FrameFormat format, uint width, uint height, uint fps)
+	: filename(filename)
+	, format(format)
+	, width(width)
+	, height(height)
+	{
+		if (filename == "-") {
+			file = stdout;
+			#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+			#endif
+			//stdout is line buffered for the text output, which doesn't make sense for this.
+			setvbuf(stdout, nullptr, _IOFBF, 1 << 20);
+		}
+		else {
+			//This also works for a FIFO. Opening it waits until there's a reader.
+			file = fopen(filename.c_str(), "wb");
+			close_file = true;
+			if (file == nullptr) {
+				cout << "error while opening file " << filename << endl;
+				error = true;
+				finished = true;
+				return;
+			}
+		}
+
+		if (format != FrameFormat::PPM) {
+			string header = "YUV4MPEG2 W" + to_string(width) + " H" + to_string(height) + " F" + to_string(fps) + ":1 Ip A1:1 "
+				+ (format == FrameFormat::Y4M_420 ? "C420jpeg" : "C444") + "\n";
+			writeBytes(header.data(), header.size());
+		}
+		writer = thread(&FrameStreamWriter::writeFrames, this);
+	}
+
+	~FrameStreamWriter() {
+		if ( ! finished)
+			finish();
+	}
+
+	bool good() {
+		return ! error;
+	}
+
+	//Adds the next frame. pixels should contain width * height colors, row by row. written is called in the thread that writes the frame, when it's written successfully.
+	void addFrame(const ARGB* pixels, std::function<void(double)> written = nullptr)
+	{
+		assert( ! finished);
+		if (finished)
+			return;
+
+		QueuedFrame frame;
+		frame.written = written;
+		{
+			unique_lock<mutex> lock(queueMutex);
+			queueChanged.wait(lock, [&]{ return queue.size() < MAXIMUM_QUEUED_FRAMES; });
+			if ( ! spare.empty()) {
+				frame.pixels = move(spare.back());
+				spare.pop_back();
+			}
+		}
+		frame.pixels.assign(pixels, pixels + (size_t)width * height);
+		{
+			lock_guard<mutex> guard(queueMutex);
+			queue.push_back(move(frame));
+		}
+		queueChanged.notify_all();
+	}
+
+	//Writes the frames that are still waiting. Returns whether all frames were written successfully.
+	bool finish()
+	{
+		if (finished)
+			return ! error;
+		finished = true;
+		{
+			lock_guard<mutex> guard(queueMutex);
+			no_more_frames = true;
+		}
+		queueChanged.notify_all();
+		writer.join();
+		if (close_file && fclose(file) != 0)
+			error = true;
+		if (error)
+			cout << "not all frames could be written to " << filename << endl;
+		return ! error;
+	}
+};
+
+#endif
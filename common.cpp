@@ -73,7 +73,10 @@ constexpr double PROGRAM_VERSION = 11.0;
 constexpr uint NUMBER_OF_TRANSFORMATIONS = 7 + 1;
 //todo: remove if the old mariani silver algortihm is not used anymore
 constexpr uint MAXIMUM_TILE_SIZE = 50; //tiles in renderSilverRect smaller than this do not get subdivided.
-constexpr uint NEW_TILE_THREAD_MIN_PIXELS = 8; //For tiles with a width or height in PIXELS smaller than this no new threads are created, which has two reasons: 1. thread overhead; 2. See the explanation of stop_creating_threads in the function Render::renderSilverRect.
+constexpr uint ITERS_BLOCK_SHIFT = 4; //the blocked layout of iteration data (see FractalCanvas::itersIndex_of_itersXY) uses blocks of 2^ITERS_BLOCK_SHIFT x 2^ITERS_BLOCK_SHIFT points
+constexpr uint BOUNDARY_TRACING_STRIP_HEIGHT = 64; //the approximate height in points of the strips that the boundary tracing algorithm divides the canvas into
+constexpr uint GRADIENT_LUT_MAXIMUM_SIZE = 1 << 20; //the maximum number of iteration counts in the lookup table of gradient colors (see GradientLUT), which is 4 MB
+constexpr uint BITMAP_TILE_SIZE = 128; //the width and height in pixels of the tiles that bitmap renders are divided into (see FractalCanvas::renderBitmapFull)
 constexpr uint WORK_STORAGE_SIZE = 256; // how much work (points to calculate) worker threads receive from the work distribution function (used in the Render class)
 constexpr double pi = 3.1415926535897932384626433832795;
 
@@ -81,6 +84,8 @@ constexpr double pi = 3.1415926535897932384626433832795;
 //Global variables
 uint NUMBER_OF_THREADS;
 bool using_avx = false;
+bool using_avx2 = false;
+bool using_blocked_layout = true; //the layout of iteration data used by new FractalCanvases
 
 mutex threadCountChange;
 mutex drawingBitmap;
@@ -212,6 +217,7 @@ public:
 	struct ProgressInfo {
 		uint64 guessedPixelCount;
 		uint64 calculatedPixelCount;
+		uint64 computedIterations; //the iterations that were executed so far
 		double elapsedTime;
 		bool ended;
 	};
@@ -224,6 +230,37 @@ public:
 	virtual ~RenderInterface() {}
 };
 
+//The time that one thread of a render spent on work and waiting for work
+struct WorkerStatistics {
+	double busy_seconds{ 0 };
+	double idle_seconds{ 0 };
+};
+
+//Numbers about a finished render, for example to find out which frames of an animation take long
+struct RenderStatistics {
+	double seconds{ 0 };
+	uint64 computed_iterations{ 0 };
+	uint64 guessed_points{ 0 };
+	uint64 calculated_points{ 0 };
+	uint64 points{ 0 }; //the number of points of the canvas
+	uint threads{ 0 }; //the number of threads that the render used
+
+	//the parts of the render
+	double raster_seconds{ 0 }; //the raster that divides the canvas into tiles (Mariani-Silver)
+	double tile_seconds{ 0 }; //the tiles, or the strips of boundary tracing
+	double bitmap_seconds{ 0 }; //coloring the bitmap during the render, added up over the threads
+	vector<WorkerStatistics> workers; //the threads that calculate the tiles or strips
+	uint64 queue_waits{ 0 }; //the number of times that a thread had to wait for a tile
+	double queue_wait_seconds{ 0 }; //the time between adding a tile to the queue and a thread taking it, added up over the tiles
+	uint64 tiles_split{ 0 };
+	uint64 tiles_filled{ 0 }; //guessed because the whole boundary has the same iteration count
+	uint64 tiles_calculated{ 0 }; //too small to split, so every point is calculated
+	bool cancelled{ false };
+	double cancel_latency{ 0 }; //the time between the cancellation and the end of the render, if cancelled. -1 if the time of the cancellation isn't known.
+	uint64 buffer_bytes{ 0 }; //the memory of the buffer pool after the render, of the whole program
+	uint64 peak_buffer_bytes{ 0 }; //the most memory that the buffer pool has had since the program started
+};
+
 enum class ResizeResultType {
 	Success,
 	OutOfRangeError,
@@ -258,6 +295,21 @@ public:
 	virtual ~GUIInterface() {}
 };
 
+//The algorithms that decide which points are calculated and which can be guessed. See Render::renderSilverFull and Render::renderBoundaryTracingFull.
+enum class RenderAlgorithm {
+	MarianiSilver,
+	BoundaryTracing
+};
+
+string render_algorithm_name(RenderAlgorithm algorithm)
+{
+	switch(algorithm) {
+		case RenderAlgorithm::MarianiSilver: return "Mariani-Silver";
+		case RenderAlgorithm::BoundaryTracing: return "boundary tracing";
+	}
+	assert(false); return "";
+}
+
 //a location in a FractalCanvas
 struct point {
 	uint x;
@@ -19,8 +19,15 @@
 #ifndef TEST_H
 #define TEST_H
 
+#include <filesystem>
+
 #include "common.cpp"
 #include "WorkDistribution.cpp"
+#include "FractalCanvas.cpp"
+#include "utilities.cpp"
+#include "IterationDataFile.cpp"
+#include "StreamingImage.cpp"
+#include "FrameManifest.cpp"
 
 //unit tests:
 
@@ -34,11 +41,33 @@ void dotest(string name, std::function<void(void)> test) {
 	cout << "Test " << name << " completed in " << elapsed.count() << " seconds" << endl;
 }
 
+//A file for a test in the temporary directory of the system, so that the tests don't write to the working directory
+string testFilename(string name) {
+	return (filesystem::temp_directory_path() / name).string();
+}
+
 bool operator==(const point& a, const point& b)
 {
 	return a.x == b.x && a.y == b.y;
 }
 
+//The number of points of the last render of canvas that don't have the iterationcount that Render::calcPoint gives them
+template <int procedure_identifier>
+uint wrongCounts(FractalCanvas& canvas)
+{
+	constexpr Procedure procedure = getProcedureObject(procedure_identifier);
+	Render<procedure_identifier, false, procedure.hasJuliaVersion> R(canvas, canvas.lastRenderID);
+	R.useCounterSlot(0);
+	uint wrong = 0;
+	uint64 iterations = 0;
+	for (uint y=0; y<canvas.P().height_canvas(); y++)
+	for (uint x=0; x<canvas.P().width_canvas(); x++) {
+		if (R.calcPoint(x, y, iterations) != canvas.getIterationcount(x, y))
+			wrong++;
+	}
+	return wrong;
+}
+
 void testfunction()
 {
 	if constexpr(debug) {
@@ -109,6 +138,526 @@ void testfunction()
 				
 			}
 		});
+
+		dotest("iters layouts are one to one", []
+		{
+			for (bool blocked : {false, true})
+			for (uint oversampling : {1, 3})
+			{
+				FractalCanvas canvas(1, make_shared<SimpleBitmapManager>(), {}, blocked);
+
+				canvas.resize(oversampling, 37, 21, 1);
+				uint width = canvas.P().width_canvas();
+				uint height = canvas.P().height_canvas();
+				uint64 size = canvas.iters_size(width, height);
+				vector<bool> used(size, false);
+
+				for (uint y=0; y<height; y++)
+				for (uint x=0; x<width; x++) {
+					uint index = canvas.itersIndex_of_itersXY(x, y);
+					assert(index < size);
+					assert( ! used[index]);
+					used[index] = true;
+				}
+			}
+		});
+
+		dotest("buffer pool reuse", []
+		{
+			BufferPool pool;
+			PooledBuffer a, b;
+			size_t large = 10 << 20;
+			assert(pool.ensureCapacity(a, large));
+			void* data = a.data;
+			//shrinking keeps the buffer
+			assert(pool.ensureCapacity(a, large / 2));
+			assert(a.data == data);
+			//a released buffer is used again
+			pool.release(a);
+			assert(a.data == nullptr);
+			assert(pool.ensureCapacity(b, large - 1));
+			assert(b.data == data);
+			//but not after a trim
+			uint64 allocated = pool.allocatedBytes();
+			pool.release(b);
+			assert(pool.allocatedBytes() == allocated);
+			pool.trim();
+			assert(pool.allocatedBytes() == 0);
+		});
+
+		dotest("iteration data round trip", []
+		{
+			for (uint maxIters : {1000, 100000})
+			{
+				FractalCanvas canvas(1, make_shared<SimpleBitmapManager>());
+				canvas.Pmutable().setMaxIters(maxIters);
+				canvas.resize(2, 13, 7, 1);
+				uint width = canvas.P().width_canvas();
+				uint height = canvas.P().height_canvas();
+
+				//The flags of neighboring points share a byte, so every point gets different values than its neighbors.
+				for (int repeat=0; repeat<2; repeat++)
+				for (uint y=0; y<height; y++)
+				for (uint x=0; x<width; x++) {
+					uint i = x + y * width + repeat;
+					canvas.setPixel(x, y, (i * 7919) % maxIters, i % 2 == 0, i % 3 == 0);
+				}
+				for (uint y=0; y<height; y++)
+				for (uint x=0; x<width; x++) {
+					uint i = x + y * width + 1;
+					IterData it = canvas.getIterData(x, y);
+					assert(it.iterationCount == (i * 7919) % maxIters);
+					assert(it.guessed == (i % 2 == 0));
+					assert(it.inMinibrot == (i % 3 == 0));
+				}
+			}
+		});
+
+		dotest("count width of procedures", []
+		{
+			FractalParameters P;
+			P.setMaxIters(40000);
+			assert( ! needs_wide_counts(P));
+			P.setProcedure(RECURSIVE_FRACTAL.id); //up to 2*maxIters
+			assert(needs_wide_counts(P));
+			P.setMaxIters(1000);
+			assert( ! needs_wide_counts(P));
+			P.setProcedure(TRIPLE_MATCHMAKER.id);
+			assert(needs_wide_counts(P));
+		});
+
+		dotest("line scans", []
+		{
+			for (bool blocked : {false, true})
+			for (uint oversampling : {1, 3})
+			for (uint maxIters : {1000, 100000}) //16-bit and 32-bit counts
+			{
+				FractalCanvas canvas(1, make_shared<SimpleBitmapManager>(), {}, blocked);
+
+				canvas.Pmutable().setMaxIters(maxIters);
+				canvas.resize(oversampling, 29, 23, 1);
+				assert(canvas.wide_counts == (maxIters > UINT16_MAX));
+				uint width = canvas.P().width_canvas();
+				uint height = canvas.P().height_canvas();
+
+				//equal values except for a few points
+				for (uint y=0; y<height; y++)
+				for (uint x=0; x<width; x++) {
+					canvas.setPixel(x, y, (x % 31 == 30 || y % 37 == 36) ? maxIters - 1 : 1, false, false);
+				}
+				for (uint y=0; y<height; y += 5)
+				for (uint from=0; from<width; from += 3)
+				for (uint to=from; to<=width; to += 2) {
+					bool same = true;
+					for (uint x=from; x<to; x++)
+						same = same && canvas.getIterationcount(x, y) == canvas.getIterationcount(from, y);
+					assert(canvas.isSameHorizontalLine(from, to, y) == same);
+				}
+				for (uint x=0; x<width; x += 5)
+				for (uint from=0; from<height; from += 3)
+				for (uint to=from; to<=height; to += 2) {
+					bool same = true;
+					for (uint y=from; y<to; y++)
+						same = same && canvas.getIterationcount(x, y) == canvas.getIterationcount(x, from);
+					assert(canvas.isSameVerticalLine(from, to, x) == same);
+				}
+			}
+		});
+
+		dotest("bitmap colors", []
+		{
+			for (bool blocked : {false, true})
+			for (uint oversampling : {1, 2})
+			for (uint bitmap_zoom : {1, 3})
+			for (uint maxIters : {1000, 100000})
+			{
+				FractalCanvas canvas(1, make_shared<SimpleBitmapManager>(), {}, blocked);
+
+				canvas.Pmutable().setMaxIters(maxIters);
+				canvas.resize(oversampling, 60, 50, bitmap_zoom);
+				assert(canvas.wide_counts == (maxIters > UINT16_MAX));
+				const FractalParameters& P = canvas.P();
+				for (uint y=0; y<P.height_canvas(); y++)
+				for (uint x=0; x<P.width_canvas(); x++) {
+					uint i = x * 31 + y * 17;
+					canvas.setPixel(x, y, (i * 7919) % maxIters, false, i % 5 == 0);
+				}
+				//counts above maxIters are beyond the lookup table
+				canvas.setPixel(0, 0, maxIters + 12345, false, false);
+				canvas.renderBitmapFull(false, false);
+
+				const vector<ARGB>& colors = P.get_gradientColors();
+				for (uint py=0; py<P.height_resolution(); py++)
+				for (uint px=0; px<P.width_resolution(); px++) {
+					uint sumR=0, sumG=0, sumB=0;
+					for (uint y=py*oversampling; y<(py+1)*oversampling; y++)
+					for (uint x=px*oversampling; x<(px+1)*oversampling; x++) {
+						IterData it = canvas.getIterData(x, y);
+						ARGB c = it.inMinibrot ? rgb(0, 0, 0) : gradient(it.iterationCount, colors, colors.size(), P.get_gradientOffsetTerm(), P.get_gradientSpeedFactor());
+						sumR += c.R; sumG += c.G; sumB += c.B;
+					}
+					uint samples = oversampling * oversampling;
+					ARGB expected = rgb(sumR / samples, sumG / samples, sumB / samples);
+					assert(bitcast<uint32>(canvas.ptPixels[canvas.pixelIndex_of_pixelXY(px, py)]) == bitcast<uint32>(expected));
+				}
+			}
+		});
+
+		dotest("gradient table of the counts after a render", []
+		{
+			FractalCanvas canvas(1, make_shared<SimpleBitmapManager>());
+			canvas.Pmutable().setMaxIters(100000);
+			canvas.resize(1, 60, 50, 1);
+			canvas.createNewRender();
+			//The default view has a minibrot, but the counts outside of it are much smaller than maxIters.
+			assert(canvas.gradientLUT()->colors.size() < 1000);
+
+			vector<ARGB> colors = canvas.P().get_gradientColors();
+			colors[1] = rgb(10, 200, 30);
+			canvas.changeParameters([&](FractalParameters& P) {
+				P.setGradientColors(colors);
+			});
+			canvas.setPixel(1, 1, 99999, false, false); //beyond the table
+			canvas.renderBitmapFull(false, false);
+			const FractalParameters& P = canvas.P();
+			for (uint y=0; y<P.height_canvas(); y++)
+			for (uint x=0; x<P.width_canvas(); x++) {
+				IterData it = canvas.getIterData(x, y);
+				ARGB expected = it.inMinibrot ? rgb(0, 0, 0) : gradient(it.iterationCount, colors, colors.size(), P.get_gradientOffsetTerm(), P.get_gradientSpeedFactor());
+				assert(bitcast<uint32>(canvas.ptPixels[canvas.pixelIndex_of_pixelXY(x, y)]) == bitcast<uint32>(expected));
+			}
+		});
+
+		dotest("boundary tracing counts", []
+		{
+			//With boundary tracing selected, every procedure should give the same counts as calculating every point: the Mandelbrot procedures are boundary traced and the others use Mariani-Silver.
+			bool avx = using_avx;
+			using_avx = false; //the same calculations as calcPoint
+			FractalCanvas canvas(2, make_shared<SimpleBitmapManager>());
+			canvas.render_algorithm = RenderAlgorithm::BoundaryTracing;
+			auto check = [&](auto procedure_constant, bool julia) {
+				constexpr int id = decltype(procedure_constant)::value;
+				constexpr Procedure procedure = getProcedureObject(id);
+				if (julia && ! procedure.hasJuliaVersion)
+					return;
+				canvas.changeParameters([&](FractalParameters& P) {
+					P.setProcedure(id);
+					P.setJulia(julia);
+					P.setJuliaSeed(-0.75 + 0.1*I);
+					P.setMaxIters(500);
+				});
+				canvas.resize(1, 91, 67, 1);
+				canvas.createNewRender();
+				uint wrong = wrongCounts<id>(canvas);
+				if (wrong > 0)
+					cout << getProcedureObject(id).name() << (julia ? " julia" : "") << ": " << wrong << " wrong counts" << endl;
+				assert(wrong == 0);
+			};
+			for (bool julia : {false, true}) {
+				check(integral_constant<int, M2.id>(), julia);
+				check(integral_constant<int, BURNING_SHIP.id>(), julia);
+				check(integral_constant<int, M3.id>(), julia);
+				check(integral_constant<int, M4.id>(), julia);
+				check(integral_constant<int, M5.id>(), julia);
+				check(integral_constant<int, TRIPLE_MATCHMAKER.id>(), julia);
+				check(integral_constant<int, CHECKERS.id>(), julia);
+				check(integral_constant<int, HIGH_POWER.id>(), julia);
+				check(integral_constant<int, RECURSIVE_FRACTAL.id>(), julia);
+				check(integral_constant<int, PURE_MORPHINGS.id>(), julia);
+				check(integral_constant<int, M512.id>(), julia);
+			}
+			using_avx = avx;
+		});
+
+		dotest("cancel times of renders", []
+		{
+			FractalCanvas canvas(1, make_shared<SimpleBitmapManager>());
+			chrono::high_resolution_clock::time_point time, later;
+			int first = canvas.lastRenderID;
+			assert( ! canvas.cancelTime(first, time));
+			canvas.cancelRender();
+			assert(canvas.cancelTime(first, time));
+			//Another cancellation doesn't change the time of the first one.
+			canvas.cancelRender();
+			assert(canvas.cancelTime(first, later) && later == time);
+			assert(canvas.cancelTime(first + 1, later) && later >= time);
+			for (int i=0; i<20; i++)
+				canvas.cancelRender();
+			assert( ! canvas.cancelTime(first, time)); //forgotten
+		});
+
+		dotest("bitmap render cancellation", []
+		{
+			FractalCanvas canvas(2, make_shared<SimpleBitmapManager>());
+			canvas.resize(1, 300, 200, 1);
+			canvas.setVisibleRegion(100, 50, 40, 30);
+			int bitmapRenderID = canvas.lastBitmapRenderID;
+			assert(canvas.renderBitmapFull(false, true, bitmapRenderID));
+			canvas.cancelBitmapRender();
+			assert( ! canvas.renderBitmapFull(false, true, bitmapRenderID));
+		});
+
+		dotest("iteration data file", []
+		{
+			string filename = testFilename("iteration data test.efi");
+			FractalCanvas canvas(1, make_shared<SimpleBitmapManager>());
+			canvas.Pmutable().setMaxIters(100000);
+			canvas.resize(2, 13, 9, 1); //with padding in the blocked layout
+			uint width = canvas.P().width_canvas();
+			uint height = canvas.P().height_canvas();
+			for (uint y=0; y<height; y++)
+			for (uint x=0; x<width; x++) {
+				uint i = x + y * width;
+				canvas.setPixel(x, y, (i * 7919) % 100000, i % 2 == 0, i % 3 == 0);
+			}
+			assert(saveIterationData(canvas, filename));
+
+			FractalCanvas loaded(1, make_shared<SimpleBitmapManager>());
+			assert(loadIterationData(loaded, filename));
+			assert(loaded.P().toJson() == canvas.P().toJson());
+			for (uint y=0; y<height; y++)
+			for (uint x=0; x<width; x++) {
+				IterData a = canvas.getIterData(x, y);
+				IterData b = loaded.getIterData(x, y);
+				assert(a.iterationCount == b.iterationCount && a.guessed == b.guessed && a.inMinibrot == b.inMinibrot);
+			}
+			//The data is a private copy of the file, so it can be changed.
+			loaded.setPixel(0, 0, 5, false, false);
+			assert(loaded.getIterationcount(0, 0) == 5);
+			remove(filename.c_str());
+		});
+
+		dotest("copied parameters have the same rotation", []
+		{
+			//Two views with the same rotation angle and very different centers, as in a batch of parameter files that are rendered with one canvas. setCenterAndZoomAbsolute moves the center of rotation of Q from its old center to the new one, which isn't exact.
+			FractalParameters P;
+			P.setRotation(0.1);
+			P.setCenterAndZoomAbsolute(-0.7436438870371587 + 0.1318259042053119*I, 14);
+			FractalParameters Q;
+			Q.setRotation(0.1);
+			Q.setCenterAndZoomAbsolute(1000.123 + 77.7*I, 1);
+
+			Q.fromParameters(P);
+			assert(Q.get_center() == P.get_center());
+			assert(Q.get_center_of_rotation() == P.get_center_of_rotation());
+			for (uint y=0; y<P.height_canvas(); y += 17)
+			for (uint x=0; x<P.width_canvas(); x += 13)
+				assert(Q.rotation(Q.map(x, y)) == P.rotation(P.map(x, y)));
+		});
+
+		dotest("parameter copies share vectors", []
+		{
+			FractalParameters P;
+			P.setInflectionZoomLevel();
+			FractalParameters copy = P;
+			assert(&copy.get_inflectionCoords() == &P.get_inflectionCoords());
+			assert(&copy.get_gradientColors() == &P.get_gradientColors());
+
+			//changing the copy doesn't change the original. That's not a change of memory: the original keeps its vector.
+			shared_ptr<const vector<double_c>> held = copy.share_inflectionCoords();
+			copy.clearModified();
+			copy.addInflection(0.25 + 0.5*I);
+			assert( ! copy.modifiedMemory);
+			assert(held.get() == &P.get_inflectionCoords());
+			assert(&copy.get_inflectionCoords() != &P.get_inflectionCoords());
+			assert(P.get_inflectionCoords()[0] == double_c(0));
+			assert(copy.get_inflectionCoords()[0] == 0.25 + 0.5*I);
+
+			//setting the same values doesn't make a new vector
+			FractalParameters copy2 = copy;
+			copy2.clearModified();
+			assert( ! copy2.setGradientColors(copy.get_gradientColors()));
+			assert( ! copy2.setInflections(copy.get_inflectionCoords(), copy.get_inflectionCount()));
+			assert( ! copy2.modifiedMemory);
+			assert(&copy2.get_inflectionCoords() == &copy.get_inflectionCoords());
+		});
+
+		dotest("colors change shared with a history copy", []
+		{
+			FractalCanvas canvas(1, make_shared<SimpleBitmapManager>());
+			canvas.resize(1, 60, 50, 1);
+			FractalParameters history = canvas.P(); //like the GUI history, which shares the vectors with the canvas
+			canvas.Pmutable().clearModified();
+			int renderID = canvas.lastRenderID;
+
+			vector<ARGB> colors = canvas.P().get_gradientColors();
+			colors[0] = rgb(1, 2, 3);
+			canvas.changeParameters([&](FractalParameters& P) {
+				P.setGradientColors(colors);
+			});
+			//Only the colors changed, so the render isn't cancelled.
+			assert(canvas.lastRenderID == renderID);
+			assert(canvas.P().modifiedColors);
+			assert( ! canvas.P().modifiedMemory && ! canvas.P().modifiedCalculations);
+			assert(bitcast<uint32>(canvas.P().get_gradientColors()[0]) == bitcast<uint32>(colors[0]));
+			assert(bitcast<uint32>(history.get_gradientColors()[0]) != bitcast<uint32>(colors[0]));
+		});
+
+		dotest("adler32 combine", []
+		{
+			vector<uint8> data(200000);
+			for (uint i=0; i<data.size(); i++)
+				data[i] = (uint8)(i * 2654435761u >> 24);
+			for (size_t split : {0, 1, 5552, 65521, 150000}) {
+				uint first = update_adler32(1, data.data(), (uint)split);
+				uint second = update_adler32(1, data.data() + split, (uint)(data.size() - split));
+				assert(adler32_combine(first, second, data.size() - split) == update_adler32(1, data.data(), (uint)data.size()));
+			}
+		});
+
+		dotest("frame selection", []
+		{
+			FrameSelection all;
+			for (int number=1; number<=20; number++)
+				assert(all.contains(number));
+
+			FrameSelection range;
+			range.skipframes = 3;
+			range.first = 2;
+			range.last = 8;
+			for (int number=1; number<=20; number++)
+				assert(range.contains(number) == (number >= 4 && number <= 8));
+
+			//The shards together have every frame exactly once.
+			for (uint shard_count : {1, 2, 3, 7}) {
+				vector<int> rendered(21, 0);
+				for (uint shard=1; shard<=shard_count; shard++) {
+					FrameSelection part;
+					part.shard = shard;
+					part.shard_count = shard_count;
+					for (int number=1; number<=20; number++)
+						rendered[number] += part.contains(number);
+				}
+				for (int number=1; number<=20; number++)
+					assert(rendered[number] == 1);
+			}
+		});
+
+		dotest("frame manifest", []
+		{
+			string directory = testFilename("");
+			string manifestName = "frames test.manifest";
+			string frame = "frame_test.png"; //frame names have no spaces
+			remove((directory + manifestName).c_str());
+			{
+				ofstream file(directory + frame, ios::binary);
+				file << "not really a PNG file";
+			}
+			uint checksum;
+			assert(fileChecksum(directory + frame, checksum));
+			{
+				FrameManifest manifest(directory, manifestName);
+				assert( ! manifest.isCompleted(frame, 1234));
+				manifest.add(frame, 1234, checksum);
+			}
+			{
+				FrameManifest manifest(directory, manifestName);
+				assert(manifest.isCompleted(frame, 1234));
+				assert( ! manifest.isCompleted(frame, 1235)); //other parameters
+				assert( ! manifest.isCompleted("other_frame.png", 1234));
+			}
+			{
+				ofstream file(directory + frame, ios::binary);
+				file << "not really a PNG File"; //the same size, so only the checksum shows the change
+			}
+			{
+				FrameManifest manifest(directory, manifestName);
+				assert(manifest.isCompleted(frame, 1234));
+				assert( ! manifest.isCompleted(frame, 1234, true));
+			}
+			{
+				ofstream file(directory + frame, ios::binary);
+				file << "an unfinished file";
+			}
+			{
+				FrameManifest manifest(directory, manifestName);
+				assert( ! manifest.isCompleted(frame, 1234));
+			}
+			{
+				//a line without the size, as in older manifests, is checked with the checksum
+				assert(fileChecksum(directory + frame, checksum));
+				ofstream file(directory + manifestName, ios::binary);
+				file << frame << " " << hex << 1234 << " " << checksum << "\n";
+			}
+			{
+				FrameManifest manifest(directory, manifestName);
+				assert(manifest.isCompleted(frame, 1234));
+				ofstream file(directory + frame, ios::binary);
+				file << "an unfinished File";
+			}
+			{
+				FrameManifest manifest(directory, manifestName);
+				assert( ! manifest.isCompleted(frame, 1234));
+			}
+			remove((directory + frame).c_str());
+			remove((directory + manifestName).c_str());
+		});
+
+		dotest("band render", []
+		{
+			string filename = testFilename("band render test.png");
+			//The last band is shorter than band_height: 3 rows, 1 row (which is too short for a render) and 1 row with oversampling 2.
+			for (auto [oversampling, band_height] : { pair<uint, uint>{1, 5}, {1, 11}, {2, 2} })
+			{
+				FractalParameters P;
+				P.setProcedure(CHECKERS.id); //not guessable, so rendering in bands gives the same result as rendering at once
+				P.setMaxIters(200);
+				P.resize(40, 23, oversampling, 1);
+				FractalCanvas canvas(1, make_shared<SimpleBitmapManager>());
+				canvas.changeParameters(P);
+				canvas.createNewRender();
+
+				assert(renderImageInBands(P, band_height, RenderAlgorithm::MarianiSilver, 1, filename));
+				vector<uint8> image;
+				uint width, height;
+				assert(lodepng::decode(image, width, height, filename, LCT_RGB) == 0);
+				assert(width == 40 && height == 23);
+				for (uint y=0; y<height; y++)
+				for (uint x=0; x<width; x++) {
+					ARGB c = canvas.ptPixels[canvas.pixelIndex_of_pixelXY(x, y)];
+					const uint8* png = &image[3 * ((size_t)y * width + x)];
+					assert(png[0] == c.R && png[1] == c.G && png[2] == c.B);
+				}
+				//bands of 1 row have only 2 rows of points
+				if (oversampling == 2)
+					assert( ! renderImageInBands(P, 1, RenderAlgorithm::MarianiSilver, 1, filename));
+			}
+			remove(filename.c_str());
+		});
+
+		dotest("saved color types", []
+		{
+			string filename = testFilename("color type test.png");
+			PNGCompressionThreads compression_threads(3); //used for all images, like in ImageSaveQueue
+			//700 * 700 RGB pixels are more than one block, so that the threads are used.
+			for (auto [colors, size, colortype, bitdepth] : {
+				tuple<uint, uint, LodePNGColorType, uint>{2, 30, LCT_PALETTE, 1}
+				,{200, 40, LCT_PALETTE, 8}
+				,{1000, 700, LCT_RGB, 8}
+				,{0, 50, LCT_GREY, 8} //grey
+			})
+			{
+				vector<ARGB> pixels((size_t)size * size);
+				for (size_t i=0; i<pixels.size(); i++) {
+					uint8 v = (uint8)(i * 7);
+					pixels[i] = colors == 0 ? rgb(v, v, v) : rgb((uint8)(i % colors), (uint8)(i % colors / 256 * 50), 100);
+				}
+				assert(savePixels(pixels.data(), size, size, compression_threads, filename));
+
+				vector<uint8> file;
+				assert(lodepng::load_file(file, filename) == 0);
+				lodepng::State state;
+				vector<uint8> image;
+				uint width, height;
+				state.info_raw.colortype = LCT_RGB;
+				assert(lodepng::decode(image, width, height, state, file) == 0);
+				assert(width == size && height == size);
+				assert(state.info_png.color.colortype == colortype && state.info_png.color.bitdepth == bitdepth);
+				for (size_t i=0; i<pixels.size(); i++)
+					assert(image[3*i] == pixels[i].R && image[3*i + 1] == pixels[i].G && image[3*i + 2] == pixels[i].B);
+			}
+			remove(filename.c_str());
+		});
 	}
 }
 
@@ -21,6 +21,18 @@
 
 //standard library
 #include <fstream>
+#include <atomic>
+#include <memory>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 //this program
 #include "common.cpp"
@@ -37,17 +49,284 @@ string getDate() {
 	return s.str();
 }
 
+/*
+	Appends text to the file filename, which is created if it doesn't exist. Returns false if that fails.
+	Several processes can append to the same file at the same time, for example the shards of an animation (see --shard) that share a manifest. The file is locked during the write, so their lines don't overwrite or interleave each other. fopen with "a" isn't enough for that on Windows, where the C runtime moves to the end of the file and then writes, and another process can write in between.
+*/
+bool appendLine(string filename, const string& text)
+{
+	bool success = false;
+#ifdef _WIN32
+	//With FILE_APPEND_DATA and without FILE_WRITE_DATA, every write goes to the end of the file. LockFileEx needs the read access.
+	HANDLE file = CreateFileA(filename.c_str(), FILE_APPEND_DATA | GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	OVERLAPPED whole_file = {};
+	if (LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &whole_file)) {
+		DWORD written = 0;
+		success = WriteFile(file, text.data(), (DWORD)text.size(), &written, nullptr) && written == text.size();
+		UnlockFileEx(file, 0, MAXDWORD, MAXDWORD, &whole_file);
+	}
+	CloseHandle(file);
+#elif defined(__linux__)
+	int fd = open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (fd == -1)
+		return false;
+	if (flock(fd, LOCK_EX) == 0) {
+		success = write(fd, text.data(), text.size()) == (ssize_t)text.size();
+		flock(fd, LOCK_UN);
+	}
+	close(fd);
+#else
+	FILE* file = fopen(filename.c_str(), "ab");
+	if (file == nullptr)
+		return false;
+	success = fwrite(text.data(), 1, text.size(), file) == text.size();
+	fclose(file);
+#endif
+	return success;
+}
+
+struct PooledBuffer {
+	void* data{ nullptr };
+	size_t capacity{ 0 };
+	bool mapped_file{ false }; //see BufferPool::mapFile
+};
+
+/*
+	Keeps large buffers around for reuse, for the iteration data and bitmaps. Resizing a canvas used to free and allocate hundreds of megabytes every time, and every page of the new memory has to be faulted in again when it's written the first time.
+
+	A user of the pool keeps a PooledBuffer and calls ensureCapacity before every use. That only replaces the buffer if it's too small, so shrinking never reallocates. Buffers that are released (for example when a tab is closed) are kept for the next user, up to MAXIMUM_IDLE_BUFFERS, until the next size change of a canvas frees them (see trim).
+
+	Large buffers are aligned to 2 MB and marked for transparent huge pages on Linux, which makes page faults and TLB misses much rarer. Windows only has large pages for programs with the SeLockMemoryPrivilege, which users normally don't have, so there it's a normal malloc.
+*/
+class BufferPool {
+	static constexpr size_t LARGE_BUFFER_SIZE = 1 << 22; //smaller buffers are simply malloc'ed and freed
+	static constexpr size_t HUGE_PAGE_SIZE = 1 << 21;
+	static constexpr uint MAXIMUM_IDLE_BUFFERS = 4;
+
+	mutex m;
+	vector<PooledBuffer> idle;
+	atomic<uint64> allocated{ 0 }; //the memory of all buffers, including the idle ones
+	atomic<uint64> peak{ 0 };
+
+	void changeAllocated(int64 bytes)
+	{
+		uint64 now = allocated += bytes;
+		uint64 old_peak = peak;
+		while (now > old_peak && ! peak.compare_exchange_weak(old_peak, now));
+	}
+
+	static void* allocateLarge(size_t capacity)
+	{
+#ifdef __linux__
+		//Map a little more to be able to align to a huge page.
+		size_t mapped = capacity + HUGE_PAGE_SIZE;
+		uint8* p = (uint8*)mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			return nullptr;
+		uint8* aligned = (uint8*)(((uintptr_t)p + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+		if (aligned > p)
+			munmap(p, aligned - p);
+		if (aligned + capacity < p + mapped)
+			munmap(aligned + capacity, (p + mapped) - (aligned + capacity));
+		madvise(aligned, capacity, MADV_HUGEPAGE);
+		return aligned;
+#else
+		return malloc(capacity);
+#endif
+	}
+
+	void deallocate(PooledBuffer& buffer)
+	{
+		changeAllocated(-(int64)buffer.capacity);
+		if (buffer.mapped_file) {
+#ifdef _WIN32
+			UnmapViewOfFile(buffer.data);
+#elif defined(__linux__)
+			munmap(buffer.data, buffer.capacity);
+#else
+			free(buffer.data);
+#endif
+		}
+		else if (buffer.capacity >= LARGE_BUFFER_SIZE) {
+#ifdef __linux__
+			munmap(buffer.data, buffer.capacity);
+#else
+			free(buffer.data);
+#endif
+		}
+		else {
+			free(buffer.data);
+		}
+		buffer = {};
+	}
+
+	/*
+		New memory gets mapped to physical memory when it's written the first time, which for a large buffer takes a lot of time during the first render. Linux (since 5.14) can do that in advance in one call, with the huge pages. Elsewhere, or if the kernel doesn't support it, the pages are mapped when the render threads write them.
+	*/
+	static void firstTouch(void* data, size_t size)
+	{
+#if defined(__linux__) && defined(MADV_POPULATE_WRITE)
+		madvise(data, size, MADV_POPULATE_WRITE);
+#endif
+	}
+
+public:
+	~BufferPool() {
+		for (PooledBuffer& buffer : idle)
+			deallocate(buffer);
+	}
+
+	/*
+		Makes sure that buffer has room for at least size bytes. If the buffer has to be replaced, the contents are not kept. Returns false if allocating memory failed, in which case the buffer is empty.
+	*/
+	bool ensureCapacity(PooledBuffer& buffer, size_t size)
+	{
+		if (buffer.capacity >= size)
+			return true;
+		release(buffer);
+
+		if (size < LARGE_BUFFER_SIZE) {
+			buffer.data = malloc(size);
+			buffer.capacity = buffer.data != nullptr ? size : 0;
+			changeAllocated(buffer.capacity);
+			return buffer.data != nullptr;
+		}
+
+		{
+			//use the smallest idle buffer that's large enough
+			lock_guard<mutex> guard(m);
+			auto best = idle.end();
+			for (auto it = idle.begin(); it != idle.end(); it++) {
+				if (it->capacity >= size && (best == idle.end() || it->capacity < best->capacity))
+					best = it;
+			}
+			if (best != idle.end()) {
+				buffer = *best;
+				idle.erase(best);
+				if(debug) cout << "reusing buffer of " << buffer.capacity << " bytes" << endl;
+				return true;
+			}
+		}
+
+		size_t capacity = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+		void* data = allocateLarge(capacity);
+		if (data == nullptr) {
+			//The idle buffers may be in the way.
+			{
+				lock_guard<mutex> guard(m);
+				for (PooledBuffer& idle_buffer : idle)
+					deallocate(idle_buffer);
+				idle.clear();
+			}
+			data = allocateLarge(capacity);
+			if (data == nullptr)
+				return false;
+		}
+		buffer.data = data;
+		buffer.capacity = capacity;
+		changeAllocated(capacity);
+		firstTouch(data, capacity);
+		return true;
+	}
+
+	/*
+		Makes buffer a copy-on-write mapping of size bytes of a file, starting at offset, which has to be a multiple of 64 KB on Windows. The operating system reads the file when the memory is used, so this takes the same time for any size. Changes to the buffer don't go to the file. Returns false if mapping the file failed, in which case the buffer is empty.
+		A mapped buffer isn't kept in the pool when it's released.
+	*/
+	bool mapFile(PooledBuffer& buffer, string filename, uint64 offset, size_t size)
+	{
+		release(buffer);
+		void* data = nullptr;
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (mapping == nullptr)
+			return false;
+		data = MapViewOfFile(mapping, FILE_MAP_COPY, (DWORD)(offset >> 32), (DWORD)offset, size);
+		CloseHandle(mapping); //the view keeps the mapping alive
+		if (data == nullptr)
+			return false;
+#elif defined(__linux__)
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd == -1)
+			return false;
+		data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+		close(fd);
+		if (data == MAP_FAILED)
+			return false;
+#else
+		//without memory mapping, the file is read
+		ifstream file(filename, ios::binary);
+		data = malloc(size);
+		if (data == nullptr)
+			return false;
+		file.seekg(offset);
+		if ( ! file.read((char*)data, size)) {
+			free(data);
+			return false;
+		}
+#endif
+		buffer.data = data;
+		buffer.capacity = size;
+		buffer.mapped_file = true;
+		changeAllocated(size);
+		return true;
+	}
+
+	uint64 allocatedBytes() { return allocated; }
+	uint64 peakBytes() { return peak; }
+
+	//Gives the buffer back to the pool. Afterwards the buffer is empty.
+	void release(PooledBuffer& buffer)
+	{
+		if (buffer.data == nullptr)
+			return;
+		if (buffer.capacity < LARGE_BUFFER_SIZE || buffer.mapped_file) {
+			deallocate(buffer);
+			return;
+		}
+		lock_guard<mutex> guard(m);
+		idle.push_back(buffer);
+		if (idle.size() > MAXIMUM_IDLE_BUFFERS) {
+			//forget the oldest
+			deallocate(idle.front());
+			idle.erase(idle.begin());
+		}
+		buffer = {};
+	}
+
+	//Frees the idle buffers. After a size change the buffers that it didn't use again are probably not needed anymore, and they can be hundreds of megabytes.
+	void trim()
+	{
+		lock_guard<mutex> guard(m);
+		for (PooledBuffer& buffer : idle)
+			deallocate(buffer);
+		idle.clear();
+	}
+};
+
+BufferPool bufferPool;
+
 class SimpleBitmapManager : public BitmapManager {
+	PooledBuffer buffer;
 public:
 	ARGB* ptPixels{ nullptr };
 
 	ARGB* realloc(uint width, uint height) {
-		ptPixels = (ARGB*)malloc(width * height * sizeof(ARGB));
+		if (bufferPool.ensureCapacity(buffer, (size_t)width * height * sizeof(ARGB)))
+			ptPixels = (ARGB*)buffer.data;
+		else
+			ptPixels = nullptr;
 		return ptPixels;
 	}
 
 	~SimpleBitmapManager() {
-		free(ptPixels);
+		bufferPool.release(buffer);
 	}
 };
 
@@ -100,4 +379,30 @@ inline To bitcast(From from) {
     return to;
 }
 
+/*
+	A shared_ptr that one thread can replace while other threads read it. A plain shared_ptr can't be used like that: reading and assigning the same shared_ptr object at the same time is undefined behavior, even though the reference count itself is atomic.
+	With c++20 this is atomic<shared_ptr>. Before that, the atomic functions for shared_ptr do the same (c++20 deprecates them).
+*/
+template <typename T>
+class AtomicSharedPtr {
+#ifdef __cpp_lib_atomic_shared_ptr
+	atomic<shared_ptr<T>> p;
+public:
+	inline shared_ptr<T> load() const { return p.load(); }
+	inline void store(shared_ptr<T> value) { p.store(std::move(value)); }
+#else
+	shared_ptr<T> p;
+public:
+	inline shared_ptr<T> load() const { return atomic_load(&p); }
+	inline void store(shared_ptr<T> value) { atomic_store(&p, std::move(value)); }
+#endif
+
+	AtomicSharedPtr(shared_ptr<T> value = nullptr) { store(std::move(value)); }
+	AtomicSharedPtr(const AtomicSharedPtr& other) { store(other.load()); }
+	AtomicSharedPtr& operator=(const AtomicSharedPtr& other) {
+		store(other.load());
+		return *this;
+	}
+};
+
 #endif
\ No newline at end of file